@@ -0,0 +1,228 @@
+#pragma once
+
+#include <stackless/async_task.hpp>
+#include <stackless/frame_pool.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Class declarations
+////////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class AsyncGenerator;
+
+namespace detail {
+
+template <class T>
+class AsyncGeneratorPromise;
+
+template <class T>
+class AsyncGeneratorNextAwaiter;
+
+/// Transfers control from the producer back to the consumer.
+class ProducerYieldAwaitable {
+public:
+    explicit ProducerYieldAwaitable(std::coroutine_handle<> consumer) noexcept
+        : consumer_(consumer) {
+    }
+
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+        return consumer_;
+    }
+
+    void await_resume() noexcept {
+    }
+
+private:
+    std::coroutine_handle<> consumer_;
+};
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+// Methods declarations
+////////////////////////////////////////////////////////////////////////////////
+
+/// Lazy asynchronous sequence: the producer may `co_await` between its
+/// `co_yield`s, the consumer awaits every element with `co_await Next()`.
+///
+/// Control is passed between producer and consumer by symmetric transfer.
+/// Yielded values are not copied, `Next()` returns a pointer to the object
+/// passed to `co_yield`, which stays valid until the next call.
+///
+///   while (auto row = co_await rows.Next()) { ... }
+template <class T>
+class AsyncGenerator {
+public:
+    /// Define promise type for compiler.
+    using promise_type = detail::AsyncGeneratorPromise<T>;
+
+    /// Default-constructable.
+    ///
+    /// Postconditions:
+    /// - `IsValid() == false`
+    AsyncGenerator() noexcept = default;
+
+    /// Not copyable.
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    /// Movable.
+    AsyncGenerator(AsyncGenerator&& other) noexcept : handle_(std::exchange(other.handle_, {})) {
+    }
+
+    AsyncGenerator& operator=(AsyncGenerator&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    /// Checks whether this generator holds coroutine.
+    bool IsValid() const noexcept {
+        return handle_ != nullptr;
+    }
+
+    /// Resumes the producer up to its next `co_yield`. The awaiter returns a
+    /// pointer to the yielded value or nullptr once the sequence is exhausted,
+    /// and rethrows the exception of the producer.
+    ///
+    /// Preconditions:
+    /// - `IsValid() == true` (else throws AsyncTaskInvalid)
+    detail::AsyncGeneratorNextAwaiter<T> Next() {
+        if (!IsValid()) {
+            throw AsyncTaskInvalid();
+        }
+        return detail::AsyncGeneratorNextAwaiter<T>(handle_);
+    }
+
+    // The producer may be destroyed at any of its suspension points.
+    ~AsyncGenerator() noexcept {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+private:
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) noexcept
+        : handle_(handle) {
+    }
+
+    friend promise_type;
+
+    std::coroutine_handle<promise_type> handle_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+template <class T>
+class AsyncGeneratorPromise {
+public:
+    using ValueType = std::remove_reference_t<T>;
+
+    // Frames are recycled through the per-thread frame pool
+    static void* operator new(std::size_t size) {
+        return AllocateFrame(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept {
+        DeallocateFrame(frame, size);
+    }
+
+    AsyncGenerator<T> get_return_object() noexcept {
+        return AsyncGenerator<T>(std::coroutine_handle<AsyncGeneratorPromise>::from_promise(*this));
+    }
+
+    // The producer starts on the first Next()
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    // The consumer observes the end of the sequence as a null value
+    ProducerYieldAwaitable final_suspend() noexcept {
+        value_ = nullptr;
+        return ProducerYieldAwaitable(consumer_);
+    }
+
+    // The yielded object outlives the suspension, only its address is kept.
+    ProducerYieldAwaitable yield_value(ValueType& value) noexcept {
+        value_ = std::addressof(value);
+        return ProducerYieldAwaitable(consumer_);
+    }
+
+    ProducerYieldAwaitable yield_value(ValueType&& value) noexcept {
+        value_ = std::addressof(value);
+        return ProducerYieldAwaitable(consumer_);
+    }
+
+    void return_void() noexcept {
+    }
+
+    void unhandled_exception() noexcept {
+        exception_ = std::current_exception();
+    }
+
+    void SetConsumer(std::coroutine_handle<> consumer) noexcept {
+        consumer_ = consumer;
+    }
+
+    ValueType* TakeValue() {
+        if (exception_) {
+            std::rethrow_exception(std::exchange(exception_, {}));
+        }
+        return value_;
+    }
+
+private:
+    ValueType* value_ = nullptr;
+    std::coroutine_handle<> consumer_{};
+    std::exception_ptr exception_{};
+};
+
+template <class T>
+class AsyncGeneratorNextAwaiter {
+public:
+    using ValueType = std::remove_reference_t<T>;
+
+    explicit AsyncGeneratorNextAwaiter(
+        std::coroutine_handle<AsyncGeneratorPromise<T>> producer) noexcept
+        : producer_(producer) {
+    }
+
+    // An exhausted generator is not resumed again
+    bool await_ready() noexcept {
+        return producer_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+        producer_.promise().SetConsumer(consumer);
+        return producer_;
+    }
+
+    ValueType* await_resume() {
+        return producer_.promise().TakeValue();
+    }
+
+private:
+    std::coroutine_handle<AsyncGeneratorPromise<T>> producer_;
+};
+
+}  // namespace detail
+
+}  // namespace coro
@@ -1,5 +1,13 @@
 #include "async_task.hpp"
 
+#ifdef LINES_THREADS
+#include <condition_variable>
+#include <mutex>
+#else
+#include <lines/fibers/scheduler.hpp>
+#include <libassert/assert.hpp>
+#endif
+
 namespace coro {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -12,7 +20,74 @@ const char* AsyncTaskInvalid::what() const noexcept {
 
 namespace detail {
 
-// TODO: Your solution
+namespace {
+
+#ifdef LINES_THREADS
+
+class ThreadWaiter : public CompletionWaiter {
+public:
+    std::coroutine_handle<> OnComplete(std::coroutine_handle<>) noexcept override {
+        std::lock_guard guard(mutex_);
+        ready_ = true;
+        condvar_.notify_one();
+        return std::noop_coroutine();
+    }
+
+    void Wait() {
+        std::unique_lock lock(mutex_);
+        condvar_.wait(lock, [this] { return ready_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condvar_;
+    bool ready_ = false;
+};
+
+#else
+
+// Lives on the stack of the parked fiber.
+class FiberWaiter : public CompletionWaiter, public lines::IAwaitable {
+public:
+    explicit FiberWaiter(Completion* completion) : completion_(completion) {
+    }
+
+    void Park(lines::Fiber* fiber) override {
+        fiber_ = fiber;
+        if (!completion_->Subscribe(this)) {
+            // Completed while the fiber was switching away
+            OnComplete({});
+        }
+    }
+
+    std::coroutine_handle<> OnComplete(std::coroutine_handle<>) noexcept override {
+        fiber_->SetState(lines::Fiber::State::Runnable);
+        lines::Scheduler::This().Schedule(fiber_);
+        return std::noop_coroutine();
+    }
+
+private:
+    Completion* completion_;
+    lines::Fiber* fiber_ = nullptr;
+};
+
+#endif
+
+}  // namespace
+
+void Completion::Wait() {
+#ifdef LINES_THREADS
+    ThreadWaiter waiter;
+    if (Subscribe(&waiter)) {
+        waiter.Wait();
+    }
+#else
+    if (!IsReady()) {
+        FiberWaiter waiter(this);
+        lines::Scheduler::This().Suspend(&waiter);
+    }
+#endif
+}
 
 }  // namespace detail
 
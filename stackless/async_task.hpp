@@ -1,10 +1,21 @@
 #pragma once
 
+#include <stackless/cancellation.hpp>
+#include <stackless/frame_pool.hpp>
+#include <stackless/frame_profiler.hpp>
+
+#include <lines/util/defer.hpp>
+
+#include <atomic>
+#include <concepts>
 #include <coroutine>
-#include <future>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <variant>
-#include <optional>
 
 namespace coro {
 
@@ -21,12 +32,15 @@ public:
 // Class declarations
 ////////////////////////////////////////////////////////////////////////////////
 
-// Don't bother with void types, just use Unit.
+// Empty result type, `AsyncTask<void>` may be used as well.
 using Unit = std::monostate;
 
 template <class T>
 class AsyncTask;
 
+template <class T>
+class Future;
+
 namespace detail {
 
 template <class T>
@@ -35,25 +49,84 @@ class AsyncTaskAwaiter;
 template <class T>
 class AsyncTaskPromise;
 
-// Forward declare FinalSuspendAwaitable with complete definition
+struct AsyncTaskAccess;
+
+struct CancellationTokenTag {};
+
+/// Someone who waits for the completion of a task started with `Run()`.
+class CompletionWaiter {
+public:
+    /// Called from the final suspend of the task.
+    /// Returns the coroutine that should be resumed next.
+    virtual std::coroutine_handle<> OnComplete(std::coroutine_handle<> task) noexcept = 0;
+
+protected:
+    ~CompletionWaiter() = default;
+};
+
+/// Completion state of a task started with `Run()`. Lives in the promise,
+/// so neither the task nor its future need a shared state allocation.
+class Completion {
+public:
+    bool IsReady() const noexcept {
+        return state_.load(std::memory_order::acquire) == kReady;
+    }
+
+    /// Registers the waiter, returns false if the task has already completed.
+    bool Subscribe(CompletionWaiter* waiter) noexcept {
+        auto expected = kPending;
+        return state_.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(waiter),
+                                              std::memory_order::acq_rel);
+    }
+
+    /// Hands the frame over to the task itself, returns false if the task
+    /// has already completed and the caller should destroy the frame.
+    bool Detach() noexcept {
+        auto expected = kPending;
+        return state_.compare_exchange_strong(expected, kDetached, std::memory_order::acq_rel);
+    }
+
+    /// Marks the task completed, returns the coroutine that should be resumed next.
+    std::coroutine_handle<> Complete(std::coroutine_handle<> self) noexcept {
+        auto state = state_.exchange(kReady, std::memory_order::acq_rel);
+        if (state == kDetached) {
+            self.destroy();
+        } else if (state != kPending) {
+            return reinterpret_cast<CompletionWaiter*>(state)->OnComplete(self);
+        }
+        return std::noop_coroutine();
+    }
+
+    /// Blocks the current fiber until the task is completed.
+    void Wait();
+
+private:
+    static constexpr uintptr_t kPending = 0;
+    static constexpr uintptr_t kReady = 1;
+    static constexpr uintptr_t kDetached = 2;
+
+    // One of the constants above or a pointer to the CompletionWaiter.
+    std::atomic<uintptr_t> state_{kPending};
+};
+
 class FinalSuspendAwaitable {
 public:
-    explicit FinalSuspendAwaitable(std::coroutine_handle<> continuation) noexcept
-        : continuation_(continuation) {
+    FinalSuspendAwaitable(std::coroutine_handle<> continuation, Completion* completion) noexcept
+        : continuation_(continuation), completion_(completion) {
     }
     
     bool await_ready() noexcept {
         return false;
     }
     
-    std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> self) noexcept {
         // If we have a continuation, transfer control to it
         if (continuation_) {
             return continuation_;
         }
         
-        // Otherwise, return noop_coroutine which effectively destroys the coroutine
-        return std::noop_coroutine();
+        // Otherwise the task was started with Run(), notify its future
+        return completion_->Complete(self);
     }
     
     void await_resume() noexcept {
@@ -62,6 +135,114 @@ public:
 
 private:
     std::coroutine_handle<> continuation_;
+    Completion* completion_;
+};
+
+/// Awaitables that can be woken up before they are done.
+/// `Cancel()` returns false if it is too late, e.g. a lock is already handed over.
+template <class Awaitable>
+concept Cancellable = requires(std::remove_reference_t<Awaitable>& awaitable) {
+    { awaitable.Cancel() } -> std::same_as<bool>;
+};
+
+template <class Awaitable>
+concept Awaiter = requires(std::remove_reference_t<Awaitable>& awaitable) {
+    { awaitable.await_ready() } -> std::convertible_to<bool>;
+};
+
+/// Refers to an awaiter that lives until the end of the `co_await` expression.
+/// Returned by `await_transform` instead of a reference, which some compilers
+/// copy into the frame.
+template <class Awaitable>
+class AwaiterRef {
+public:
+    explicit AwaiterRef(Awaitable& awaitable) noexcept : awaitable_(awaitable) {
+    }
+
+    bool await_ready() {
+        return awaitable_.await_ready();
+    }
+
+    template <class Promise>
+    auto await_suspend(std::coroutine_handle<Promise> handle) {
+        return awaitable_.await_suspend(handle);
+    }
+
+    decltype(auto) await_resume() {
+        return awaitable_.await_resume();
+    }
+
+private:
+    Awaitable& awaitable_;
+};
+
+/// Wraps a cancellable awaitable: the token wakes it up while it is suspended,
+/// and the awaiting coroutine throws OperationCancelled instead of resuming.
+template <class Awaitable>
+class CancellableAwaiter : public CancellationCallback {
+public:
+    CancellableAwaiter(Awaitable& awaitable, const CancellationToken& token) noexcept
+        : awaitable_(awaitable), token_(&token) {
+    }
+
+    bool await_ready() {
+        return awaitable_.await_ready();
+    }
+
+    // The token may be cancelled after the task checked it, from another
+    // thread: then the awaitable is not suspended on at all
+    auto await_suspend(std::coroutine_handle<> handle) {
+        using Result = decltype(awaitable_.await_suspend(handle));
+        bool registered = Register(*token_);
+        cancelled_ = !registered;
+        if constexpr (std::is_void_v<Result>) {
+            if (registered) {
+                awaitable_.await_suspend(handle);
+            }
+            return registered;
+        } else if constexpr (std::is_same_v<Result, bool>) {
+            return registered && awaitable_.await_suspend(handle);
+        } else {
+            return registered ? std::coroutine_handle<>(awaitable_.await_suspend(handle)) : handle;
+        }
+    }
+
+    decltype(auto) await_resume() {
+        Unregister();
+        if (cancelled_) {
+            throw OperationCancelled();
+        }
+        return awaitable_.await_resume();
+    }
+
+    void OnCancel() noexcept override {
+        cancelled_ = awaitable_.Cancel();
+    }
+
+private:
+    Awaitable& awaitable_;
+    const CancellationToken* token_;
+    bool cancelled_ = false;
+};
+
+class CancellationTokenAwaiter {
+public:
+    explicit CancellationTokenAwaiter(const CancellationToken& token) noexcept : token_(token) {
+    }
+
+    bool await_ready() noexcept {
+        return true;
+    }
+
+    void await_suspend(std::coroutine_handle<>) noexcept {
+    }
+
+    CancellationToken await_resume() noexcept {
+        return token_;
+    }
+
+private:
+    const CancellationToken& token_;
 };
 
 }  // namespace detail
@@ -115,18 +296,16 @@ public:
     ///
     /// Postconditions:
     /// - `IsValid() == false`
-    std::future<T> Run() && {
+    Future<T> Run() && {
         if (!IsValid()) {
             throw AsyncTaskInvalid();
         }
         
-        auto future = handle_.promise().GetFuture();
-        
-        // Resume the coroutine
+        // Resume the coroutine, the future takes over its frame
         auto h = std::exchange(handle_, {});
         h.resume();
         
-        return future;
+        return Future<T>(h);
     }
 
     /// This method allows awaiting the current task.
@@ -160,6 +339,7 @@ private:
 
     // Friend declarations
     friend detail::AsyncTaskPromise<T>;
+    friend detail::AsyncTaskAccess;
     
     std::coroutine_handle<detail::AsyncTaskPromise<T>> handle_{};
 };
@@ -168,90 +348,215 @@ private:
 
 namespace detail {
 
-/// Promise type for AsyncTask coroutines.
-template <class T>
-class AsyncTaskPromise {
+/// Part of the promise that does not depend on the result type.
+class AsyncTaskPromiseBase {
 public:
-    AsyncTaskPromise() noexcept = default;
-    
-    // Called after the coroutine and promise is created to obtain the return object
-    AsyncTask<T> get_return_object() noexcept {
-        return AsyncTask<T>(std::coroutine_handle<AsyncTaskPromise<T>>::from_promise(*this));
+#ifdef CORO_FRAME_PROFILER
+    // Not inlined, so the return address identifies the coroutine
+    [[gnu::noinline]] static void* operator new(std::size_t size) {
+        return AllocateProfiledFrame(size, __builtin_return_address(0));
     }
-    
+
+    static void operator delete(void* frame, std::size_t size) noexcept {
+        DeallocateProfiledFrame(frame, size);
+    }
+#else
+    // Frames are recycled through the per-thread frame pool
+    static void* operator new(std::size_t size) {
+        return AllocateFrame(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept {
+        DeallocateFrame(frame, size);
+    }
+#endif
+
     // Defines the behavior of just started coroutine
     // Suspend immediately as we implement lazy-started coroutines
     std::suspend_always initial_suspend() noexcept {
         return {};
     }
     
-    // Called when `co_return expr` is called
-    void return_value(T value) noexcept {
-        result_.emplace(std::move(value));
-        if (promise_) {
-            promise_->set_value(std::move(*result_));
-            result_.reset();
-        }
-    }
-    
-    // Called if the coroutine ends with an uncaught exception
-    void unhandled_exception() noexcept {
-        exception_ = std::current_exception();
-        if (promise_) {
-            promise_->set_exception(exception_);
-        }
-    }
-    
     // Defines the behavior of coroutine that has just finished its execution
     FinalSuspendAwaitable final_suspend() noexcept {
-        return FinalSuspendAwaitable(continuation_);
+        return FinalSuspendAwaitable(continuation_, &completion_);
     }
     
-    // Get future for the result
-    std::future<T> GetFuture() {
-        promise_ = std::promise<T>();
-        return promise_->get_future();
+    // Completion state observed by the future of a task started with Run()
+    Completion& GetCompletion() noexcept {
+        return completion_;
+    }
+
+    // Completes the coroutine from its current suspension point, as if it had
+    // returned. The locals are destroyed together with the frame.
+    std::coroutine_handle<> Finish(std::coroutine_handle<> self) noexcept {
+        return final_suspend().await_suspend(self);
     }
     
     // Set continuation for symmetric transfer
     void SetContinuation(std::coroutine_handle<> continuation) noexcept {
         continuation_ = continuation;
     }
-    
-    // Complete the promise with the result or exception (used for co_await)
-    void Complete() noexcept {
-        // If we already completed the promise in return_value or unhandled_exception,
-        // there's nothing more to do
+
+    const CancellationToken& GetCancellationToken() const noexcept {
+        return token_;
+    }
+
+    void SetCancellationToken(CancellationToken token) noexcept {
+        token_ = std::move(token);
+    }
+
+    // An explicitly set token takes precedence over the one of the awaiting task
+    void InheritCancellationToken(const CancellationToken& token) noexcept {
+        if (!token_.CanBeCancelled()) {
+            token_ = token;
+        }
+    }
+
+    // Awaited tasks are checked for cancellation before they start
+    template <class U>
+    AsyncTaskAwaiter<U> await_transform(AsyncTask<U>&& task) {
+        token_.ThrowIfCancellationRequested();
+        return std::move(task).operator co_await();
+    }
+
+    // Cancellable awaitables are checked and may be woken up by the token,
+    // other awaitables (e.g. unlocking) always run to completion
+    template <class Awaitable>
+    auto await_transform(Awaitable&& awaitable) {
+        using Type = std::remove_reference_t<Awaitable>;
+        if constexpr (Cancellable<Awaitable>) {
+            token_.ThrowIfCancellationRequested();
+            return CancellableAwaiter<Type>(awaitable, token_);
+        } else if constexpr (Awaiter<Awaitable>) {
+            return AwaiterRef<Type>(awaitable);
+        } else {
+            return std::forward<Awaitable>(awaitable).operator co_await();
+        }
+    }
+
+    // `co_await coro::GetCancellationToken()` returns the token of the task
+    CancellationTokenAwaiter await_transform(CancellationTokenTag) noexcept {
+        return CancellationTokenAwaiter(token_);
+    }
+
+private:
+    std::coroutine_handle<> continuation_{};
+    Completion completion_{};
+    CancellationToken token_{};
+};
+
+/// Result storage of the promise: a value or an exception, written exactly once.
+template <class T>
+class AsyncTaskResult : public AsyncTaskPromiseBase {
+public:
+    // Called when `co_return expr` is called
+    template <class U = T>
+    void return_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, U&&>) {
+        result_.template emplace<kValue>(std::forward<U>(value));
     }
     
-    // Check if we have a result
-    bool HasResult() const noexcept {
-        return result_.has_value();
+    // Called if the coroutine ends with an uncaught exception
+    void unhandled_exception() noexcept {
+        result_.template emplace<kException>(std::current_exception());
     }
     
-    // Get the result (caller must ensure HasResult() is true)
+    // Moves the result out or rethrows the exception
     T GetResult() {
-        if (!result_) {
+        if (result_.index() == kException) {
+            std::rethrow_exception(std::get<kException>(result_));
+        }
+        if (result_.index() != kValue) {
             throw std::runtime_error("No result available in coroutine");
         }
-        T temp_result = std::move(*result_);
-        result_.reset();  // Clear the optional to release any resources
-        return temp_result;
+        return std::move(std::get<kValue>(result_));
+    }
+
+    // Returns the value without taking it, if the coroutine has returned one
+    T* PeekValue() noexcept {
+        return std::get_if<kValue>(&result_);
+    }
+
+private:
+    static constexpr size_t kValue = 1;
+    static constexpr size_t kException = 2;
+
+    // Indices are used instead of types, since T may be std::monostate itself
+    std::variant<std::monostate, T, std::exception_ptr> result_{};
+};
+
+template <class T>
+class AsyncTaskResult<T&> : public AsyncTaskPromiseBase {
+public:
+    // Called when `co_return expr` is called
+    void return_value(T& value) noexcept {
+        result_.template emplace<kValue>(std::addressof(value));
+    }
+    
+    // Called if the coroutine ends with an uncaught exception
+    void unhandled_exception() noexcept {
+        result_.template emplace<kException>(std::current_exception());
+    }
+    
+    // Returns the result or rethrows the exception
+    T& GetResult() {
+        if (result_.index() == kException) {
+            std::rethrow_exception(std::get<kException>(result_));
+        }
+        if (result_.index() != kValue) {
+            throw std::runtime_error("No result available in coroutine");
+        }
+        return *std::get<kValue>(result_);
+    }
+
+private:
+    static constexpr size_t kValue = 1;
+    static constexpr size_t kException = 2;
+
+    std::variant<std::monostate, T*, std::exception_ptr> result_{};
+};
+
+template <>
+class AsyncTaskResult<void> : public AsyncTaskPromiseBase {
+public:
+    // Called when `co_return;` is called or the coroutine flows off its end
+    void return_void() noexcept {
+    }
+    
+    // Called if the coroutine ends with an uncaught exception
+    void unhandled_exception() noexcept {
+        exception_ = std::current_exception();
     }
     
-    // Get the exception (if any)
-    std::exception_ptr GetException() const noexcept {
-        return exception_;
+    // Rethrows the exception, if any
+    void GetResult() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
     }
 
 private:
-    std::optional<T> result_{};  // Use optional to avoid default construction
     std::exception_ptr exception_{};
-    std::optional<std::promise<T>> promise_{};
-    std::coroutine_handle<> continuation_{};
+};
+
+/// Promise type for AsyncTask coroutines.
+template <class T>
+class AsyncTaskPromise : public AsyncTaskResult<T> {
+public:
+    AsyncTaskPromise() noexcept = default;
     
-    // Friend declarations
-    friend AsyncTaskAwaiter<T>;
+    // Called after the coroutine and promise is created to obtain the return object
+    AsyncTask<T> get_return_object() noexcept {
+        return AsyncTask<T>(std::coroutine_handle<AsyncTaskPromise<T>>::from_promise(*this));
+    }
+};
+
+/// Gives the combinators access to the coroutine of a task.
+struct AsyncTaskAccess {
+    template <class T>
+    static std::coroutine_handle<AsyncTaskPromise<T>> GetHandle(const AsyncTask<T>& task) noexcept {
+        return task.handle_;
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -268,40 +573,32 @@ public:
         return false;  // Always suspend to set up continuation
     }
     
-    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+    template <class Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> continuation) noexcept {
         // Set continuation for symmetric transfer
         handle_.promise().SetContinuation(continuation);
+
+        // The awaited task is cancelled together with the awaiting one
+        if constexpr (std::is_base_of_v<AsyncTaskPromiseBase, Promise>) {
+            auto& token = continuation.promise().GetCancellationToken();
+            handle_.promise().InheritCancellationToken(token);
+        }
         
         // Start the awaited coroutine
         return handle_;
     }
     
+    // The frame is destroyed together with the awaiter, after the result is taken
     T await_resume() {
-        try {
-            // Check for exceptions
-            if (auto exception = handle_.promise().GetException()) {
-                std::rethrow_exception(exception);
-            }
-            
-            // Get the result
-            if (handle_.promise().HasResult()) {
-                return handle_.promise().GetResult();
-            }
-            
-            throw std::runtime_error("No result available in coroutine");
-        } catch (...) {
-            // Make sure we don't leak the coroutine frame
-            handle_.destroy();
-            handle_ = nullptr;
-            throw;  // Rethrow the exception
-        }
-        
-        // This point should never be reached due to exceptions or returns above
-        std::unreachable();
+        return handle_.promise().GetResult();
     }
 
     ~AsyncTaskAwaiter() {
         if (handle_) {
+#ifdef CORO_FRAME_PROFILER
+            // The frame did not outlive the awaiting coroutine, so it could be elided
+            MarkFrameAwaited(handle_.address());
+#endif
             handle_.destroy();
         }
     }
@@ -314,4 +611,120 @@ private:
 
 }  // namespace detail
 
+////////////////////////////////////////////////////////////////////////////////
+
+/// Result of a task started with `AsyncTask::Run`.
+///
+/// Unlike `std::future` it has no shared state: the result stays in the
+/// coroutine frame, which the future owns once the task is started.
+/// Waiting parks the current fiber instead of blocking the thread.
+template <class T>
+class Future {
+public:
+    /// Default-constructable.
+    ///
+    /// Postconditions:
+    /// - `IsValid() == false`
+    Future() noexcept = default;
+
+    /// Not copyable.
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    /// Movable.
+    Future(Future&& other) noexcept : handle_(std::exchange(other.handle_, {})) {
+    }
+
+    Future& operator=(Future&& other) noexcept {
+        if (this != &other) {
+            Release();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    /// Checks whether this future refers to a task.
+    bool IsValid() const noexcept {
+        return handle_ != nullptr;
+    }
+
+    /// Checks whether the task has completed.
+    bool IsReady() const noexcept {
+        return handle_ && handle_.promise().GetCompletion().IsReady();
+    }
+
+    /// Parks the current fiber until the task is completed.
+    void Wait() {
+        if (!IsValid()) {
+            throw AsyncTaskInvalid();
+        }
+
+        auto& completion = handle_.promise().GetCompletion();
+        if (!completion.IsReady()) {
+            completion.Wait();
+        }
+    }
+
+    /// Waits for the task and returns its result or rethrows its exception.
+    ///
+    /// Preconditions:
+    /// - `IsValid() == true` (else throws AsyncTaskInvalid)
+    ///
+    /// Postconditions:
+    /// - `IsValid() == false`
+    T get() {  // NOLINT
+        Wait();
+
+        auto handle = std::exchange(handle_, {});
+        lines::Defer destroy([handle] { handle.destroy(); });
+
+        return handle.promise().GetResult();
+    }
+
+    // If the task is still running, it destroys itself on completion.
+    ~Future() noexcept {
+        Release();
+    }
+
+private:
+    explicit Future(std::coroutine_handle<detail::AsyncTaskPromise<T>> handle) noexcept
+        : handle_(handle) {
+    }
+
+    void Release() noexcept {
+        if (handle_ && !handle_.promise().GetCompletion().Detach()) {
+            handle_.destroy();
+        }
+        handle_ = {};
+    }
+
+    friend AsyncTask<T>;
+
+    std::coroutine_handle<detail::AsyncTaskPromise<T>> handle_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Attaches the token to the task. Tasks awaited by it inherit the token,
+/// unless they have one of their own.
+///
+/// Preconditions:
+/// - `IsValid() == true` (else throws AsyncTaskInvalid)
+template <class T>
+AsyncTask<T> WithCancellation(AsyncTask<T> task, CancellationToken token) {
+    if (!task.IsValid()) {
+        throw AsyncTaskInvalid();
+    }
+
+    detail::AsyncTaskAccess::GetHandle(task).promise().SetCancellationToken(std::move(token));
+    return task;
+}
+
+/// Returns the token of the current task: `auto token = co_await GetCancellationToken();`.
+inline detail::CancellationTokenTag GetCancellationToken() noexcept {
+    return {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 }  // namespace coro
@@ -0,0 +1,99 @@
+#include "cancellation.hpp"
+
+#include <lines/fibers/scheduler.hpp>
+
+#include <mutex>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+
+const char* OperationCancelled::what() const noexcept {
+    return "Operation cancelled";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+bool CancellationState::Register(CancellationCallback* callback) noexcept {
+    std::lock_guard guard(lock_);
+    if (IsRequested()) {
+        return false;
+    }
+    callback->scheduler_ = &lines::Scheduler::This();
+    callback->submitted_ = false;
+    callbacks_.Append(callback);
+    return true;
+}
+
+void CancellationState::Unregister(CancellationCallback* callback) noexcept {
+    std::lock_guard guard(lock_);
+    callbacks_.Remove(callback);
+}
+
+void CancellationState::Request() noexcept {
+    if (requested_.exchange(true, std::memory_order::relaxed)) {
+        return;
+    }
+
+    // Callbacks may register or unregister others, so the list is re-read
+    auto here = &lines::Scheduler::This();
+    while (auto pending = TakePending(here)) {
+        if (!pending.remote) {
+            pending.callback->OnCancel();
+            continue;
+        }
+
+        // The callback may be unregistered and gone by the time the routine
+        // runs, the state is kept alive to tell
+        Ref();
+        pending.remote->Submit([this, callback = pending.callback] {
+            Fire(callback);
+            Unref();
+        });
+    }
+}
+
+auto CancellationState::TakePending(lines::Scheduler* here) noexcept -> Pending {
+    std::lock_guard guard(lock_);
+    for (auto callback = callbacks_.Head(); callback; callback = callback->Next()) {
+        if (callback->scheduler_ == here) {
+            callbacks_.Remove(callback);
+            callback->state_ = nullptr;
+            return {callback};
+        }
+        if (!callback->submitted_) {
+            callback->submitted_ = true;
+            return {callback, callback->scheduler_};
+        }
+    }
+    return {};
+}
+
+void CancellationState::Fire(CancellationCallback* callback) noexcept {
+    {
+        std::lock_guard guard(lock_);
+        // Only the address is compared: no callback registers after the
+        // request, so a listed one is the same that was submitted
+        auto listed = callbacks_.Head();
+        while (listed && listed != callback) {
+            listed = listed->Next();
+        }
+        if (!listed) {
+            return;
+        }
+        callbacks_.Remove(callback);
+        callback->state_ = nullptr;
+    }
+    callback->OnCancel();
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+CancellationSource::CancellationSource() : state_(new detail::CancellationState) {
+}
+
+}  // namespace coro
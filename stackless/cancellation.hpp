@@ -0,0 +1,238 @@
+#pragma once
+
+#include <lines/util/intrusive_list.hpp>
+#include <lines/util/intrusive_node.hpp>
+#include <lines/util/spinlock.hpp>
+
+#include <atomic>
+#include <exception>
+#include <utility>
+
+namespace lines {
+
+class Scheduler;
+
+}  // namespace lines
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Exceptions
+////////////////////////////////////////////////////////////////////////////////
+
+/// Thrown from a suspension point of a task whose token is cancelled.
+class OperationCancelled : public std::exception {
+public:
+    const char* what() const noexcept override;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Class declarations
+////////////////////////////////////////////////////////////////////////////////
+
+class CancellationToken;
+class CancellationSource;
+class CancellationCallback;
+
+namespace detail {
+
+/// Shared state of a source and its tokens, reference counted.
+class CancellationState {
+public:
+    bool IsRequested() const noexcept {
+        return requested_.load(std::memory_order::relaxed);
+    }
+
+    void Ref() noexcept {
+        refs_.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    void Unref() noexcept {
+        if (refs_.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    /// Returns false if cancellation has already been requested.
+    bool Register(CancellationCallback* callback) noexcept;
+    void Unregister(CancellationCallback* callback) noexcept;
+
+    void Request() noexcept;
+
+private:
+    struct Pending {
+        CancellationCallback* callback = nullptr;
+        // Null if the callback is taken off the list to be called here
+        lines::Scheduler* remote = nullptr;
+
+        explicit operator bool() const noexcept {
+            return callback != nullptr;
+        }
+    };
+
+    Pending TakePending(lines::Scheduler* here) noexcept;
+    void Fire(CancellationCallback* callback) noexcept;
+
+    std::atomic<bool> requested_{false};
+    std::atomic<size_t> refs_{1};
+    lines::SpinLock lock_;
+    lines::IntrusiveList<CancellationCallback> callbacks_;
+};
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+// Methods declarations
+////////////////////////////////////////////////////////////////////////////////
+
+/// Observes cancellation requests of a `CancellationSource`.
+///
+/// A task started with a token (see `WithCancellation`) passes it to every task
+/// it awaits. Such tasks throw `OperationCancelled` from their next `co_await`
+/// once cancellation is requested, and awaitables that provide `bool Cancel()`
+/// (lines sleeps, async mutex and semaphore waits) are woken up right away.
+class CancellationToken {
+public:
+    /// Default-constructable, such a token is never cancelled.
+    CancellationToken() noexcept = default;
+
+    CancellationToken(const CancellationToken& other) noexcept : state_(other.state_) {
+        if (state_) {
+            state_->Ref();
+        }
+    }
+
+    CancellationToken& operator=(const CancellationToken& other) noexcept {
+        CancellationToken(other).Swap(*this);
+        return *this;
+    }
+
+    CancellationToken(CancellationToken&& other) noexcept
+        : state_(std::exchange(other.state_, nullptr)) {
+    }
+
+    CancellationToken& operator=(CancellationToken&& other) noexcept {
+        CancellationToken(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    /// Checks whether the token is attached to a source.
+    bool CanBeCancelled() const noexcept {
+        return state_ != nullptr;
+    }
+
+    /// A single relaxed load, cheap enough for hot loops.
+    bool IsCancellationRequested() const noexcept {
+        return state_ && state_->IsRequested();
+    }
+
+    void ThrowIfCancellationRequested() const {
+        if (IsCancellationRequested()) {
+            throw OperationCancelled();
+        }
+    }
+
+    ~CancellationToken() noexcept {
+        if (state_) {
+            state_->Unref();
+        }
+    }
+
+private:
+    explicit CancellationToken(detail::CancellationState* state) noexcept : state_(state) {
+        state_->Ref();
+    }
+
+    void Swap(CancellationToken& other) noexcept {
+        std::swap(state_, other.state_);
+    }
+
+    friend CancellationSource;
+    friend CancellationCallback;
+
+    detail::CancellationState* state_ = nullptr;
+};
+
+/// Issues cancellation requests to its tokens.
+class CancellationSource {
+public:
+    CancellationSource();
+
+    /// Not copyable.
+    CancellationSource(const CancellationSource&) = delete;
+    CancellationSource& operator=(const CancellationSource&) = delete;
+
+    CancellationToken GetToken() const noexcept {
+        return CancellationToken(state_);
+    }
+
+    bool IsCancellationRequested() const noexcept {
+        return state_->IsRequested();
+    }
+
+    /// Safe to call from any thread. Each callback runs on the thread of the
+    /// scheduler it was registered on: inline if that is the current one,
+    /// otherwise submitted to it (see `lines::Scheduler::Submit`). The woken
+    /// coroutines are scheduled rather than resumed inline.
+    void RequestCancellation() noexcept {
+        state_->Request();
+    }
+
+    ~CancellationSource() noexcept {
+        state_->Unref();
+    }
+
+private:
+    detail::CancellationState* state_;
+};
+
+/// Gets notified when cancellation of a token is requested.
+///
+/// Callbacks are stored intrusively, so registration never allocates.
+/// The token must outlive the registration. A callback is registered and
+/// unregistered on the thread of one scheduler, and is called there.
+class CancellationCallback : public lines::IntrusiveNode<CancellationCallback> {
+public:
+    CancellationCallback() noexcept = default;
+
+    /// Not copyable.
+    CancellationCallback(const CancellationCallback&) = delete;
+    CancellationCallback& operator=(const CancellationCallback&) = delete;
+
+    /// Returns false if cancellation has already been requested,
+    /// in which case the callback is not called.
+    bool Register(const CancellationToken& token) noexcept {
+        if (!token.state_) {
+            return true;
+        }
+        if (!token.state_->Register(this)) {
+            return false;
+        }
+        state_ = token.state_;
+        return true;
+    }
+
+    void Unregister() noexcept {
+        if (state_) {
+            std::exchange(state_, nullptr)->Unregister(this);
+        }
+    }
+
+    /// Called at most once, the callback is unregistered before the call.
+    virtual void OnCancel() noexcept = 0;
+
+protected:
+    ~CancellationCallback() {
+        Unregister();
+    }
+
+private:
+    friend detail::CancellationState;
+
+    detail::CancellationState* state_ = nullptr;
+    lines::Scheduler* scheduler_ = nullptr;
+    // Submitted to `scheduler_` by a request from another thread
+    bool submitted_ = false;
+};
+
+}  // namespace coro
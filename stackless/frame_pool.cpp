@@ -0,0 +1,125 @@
+#include "frame_pool.hpp"
+
+#include <array>
+#include <bit>
+#include <new>
+
+namespace coro {
+
+namespace detail {
+
+namespace {
+
+constexpr size_t kMinClassShift = 6;                    // 64 B.
+constexpr size_t kMaxClassShift = 18;                   // 256 KiB.
+constexpr size_t kNumClasses = kMaxClassShift - kMinClassShift + 1;
+constexpr size_t kMaxCachedBytes = size_t{1} << 20;     // Per size class.
+constexpr size_t kMinCachedFrames = 4;
+
+constexpr size_t ClassSize(size_t index) {
+    return size_t{1} << (kMinClassShift + index);
+}
+
+constexpr size_t ClassIndex(size_t size) {
+    if (size <= ClassSize(0)) {
+        return 0;
+    }
+    return std::bit_width((size - 1) >> kMinClassShift);
+}
+
+class FramePool {
+public:
+    FramePool() = default;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    ~FramePool() {
+        for (size_t index = 0; index < kNumClasses; ++index) {
+            while (auto block = classes_[index].head) {
+                classes_[index].head = block->next;
+                ::operator delete(block, ClassSize(index));
+            }
+        }
+    }
+
+    void* Allocate(size_t size) {
+        auto index = ClassIndex(size);
+        if (index >= kNumClasses) {
+            ++stats_.misses;
+            return ::operator new(size);
+        }
+
+        auto& size_class = classes_[index];
+        if (auto block = size_class.head) {
+            size_class.head = block->next;
+            --size_class.count;
+            ++stats_.hits;
+            return block;
+        }
+
+        ++stats_.misses;
+        return ::operator new(ClassSize(index));
+    }
+
+    void Deallocate(void* frame, size_t size) noexcept {
+        auto index = ClassIndex(size);
+        if (index >= kNumClasses) {
+            ::operator delete(frame, size);
+            return;
+        }
+
+        auto& size_class = classes_[index];
+        if (size_class.count >= MaxCachedFrames(index)) {
+            ::operator delete(frame, ClassSize(index));
+            return;
+        }
+
+        auto block = ::new (frame) FreeBlock{size_class.head};
+        size_class.head = block;
+        ++size_class.count;
+    }
+
+    FramePoolStats GetStats() const noexcept {
+        return stats_;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct SizeClass {
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+    };
+
+    static constexpr size_t MaxCachedFrames(size_t index) {
+        auto frames = kMaxCachedBytes / ClassSize(index);
+        return frames < kMinCachedFrames ? kMinCachedFrames : frames;
+    }
+
+private:
+    std::array<SizeClass, kNumClasses> classes_{};
+    FramePoolStats stats_{};
+};
+
+thread_local FramePool pool;
+
+}  // namespace
+
+void* AllocateFrame(size_t size) {
+    return pool.Allocate(size);
+}
+
+void DeallocateFrame(void* frame, size_t size) noexcept {
+    pool.Deallocate(frame, size);
+}
+
+}  // namespace detail
+
+FramePoolStats GetFramePoolStats() noexcept {
+    return detail::pool.GetStats();
+}
+
+}  // namespace coro
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame pool
+////////////////////////////////////////////////////////////////////////////////
+
+/// Counters of the calling thread's coroutine frame pool.
+struct FramePoolStats {
+    /// Frames served from the free lists.
+    size_t hits = 0;
+    /// Frames that had to be requested from the global allocator.
+    size_t misses = 0;
+};
+
+FramePoolStats GetFramePoolStats() noexcept;
+
+namespace detail {
+
+/// Frames are rounded up to power-of-two size classes and recycled through
+/// per-thread free lists, so steady-state allocation never reaches malloc.
+/// A frame may be released on any thread, it is cached by the releasing one.
+void* AllocateFrame(size_t size);
+void DeallocateFrame(void* frame, size_t size) noexcept;
+
+}  // namespace detail
+
+}  // namespace coro
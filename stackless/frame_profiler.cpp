@@ -0,0 +1,186 @@
+#include "frame_profiler.hpp"
+#include "frame_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+namespace coro {
+
+namespace detail {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the frame aligned as `operator new` would.
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameHeader {
+    FrameProfileEntry* site;
+    Clock::rep start;
+    bool awaited;
+};
+
+size_t LifetimeBucket(Clock::duration lifetime) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(lifetime).count();
+    size_t bucket = 0;
+    for (int64_t bound = 1; bucket + 1 < kFrameLifetimeBuckets && us >= bound; bound *= 10) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+std::string Symbolize(const void* site) {
+    Dl_info info;
+    if (!dladdr(site, &info)) {
+        info = {};
+    }
+    if (info.dli_sname) {
+        int status = 0;
+        std::unique_ptr<char, decltype(&std::free)> demangled(
+            abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &std::free);
+        return status == 0 ? demangled.get() : info.dli_sname;
+    }
+
+    // Static functions are not exported: addr2line resolves the offset
+    // within the object, which does not depend on where it was loaded
+    std::ostringstream out;
+    if (info.dli_fname && info.dli_fbase) {
+        auto offset = static_cast<const char*>(site) - static_cast<const char*>(info.dli_fbase);
+        out << info.dli_fname << "+0x" << std::hex << offset;
+    } else {
+        out << site;
+    }
+    return out.str();
+}
+
+void DumpAtExit();
+
+// Frames may be released on any thread and after the main returns,
+// so the registry is never destroyed.
+class Registry {
+public:
+    static Registry& Instance() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    FrameProfileEntry* Allocated(const void* address, size_t size) {
+        std::lock_guard guard(mutex_);
+        auto& site = sites_[address];
+        site.frame_size = std::max(site.frame_size, size);
+        ++site.allocations;
+        site.peak_live = std::max(site.peak_live, ++site.live);
+        return &site;
+    }
+
+    void Released(FrameProfileEntry* site, Clock::duration lifetime, bool awaited) {
+        std::lock_guard guard(mutex_);
+        --site->live;
+        ++site->lifetimes[LifetimeBucket(lifetime)];
+        if (awaited) {
+            ++site->elidable;
+        }
+    }
+
+    std::vector<FrameProfileEntry> Snapshot() {
+        std::vector<std::pair<const void*, FrameProfileEntry>> sites;
+        {
+            std::lock_guard guard(mutex_);
+            for (auto& [address, site] : sites_) {
+                sites.emplace_back(address, site);
+            }
+        }
+
+        // Symbolization is slow, so it is done outside of the lock
+        std::vector<FrameProfileEntry> entries;
+        entries.reserve(sites.size());
+        for (auto& [address, entry] : sites) {
+            entry.function = Symbolize(address);
+            entries.push_back(std::move(entry));
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.allocations > rhs.allocations;
+        });
+        return entries;
+    }
+
+private:
+    Registry() {
+        std::atexit(DumpAtExit);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<const void*, FrameProfileEntry> sites_;
+};
+
+void DumpAtExit() {
+    DumpFrameProfile(std::cerr);
+}
+
+FrameHeader* GetHeader(void* frame) {
+    return static_cast<FrameHeader*>(frame) - 1;
+}
+
+}  // namespace
+
+void* AllocateProfiledFrame(size_t size, const void* site) {
+    auto header = static_cast<FrameHeader*>(AllocateFrame(sizeof(FrameHeader) + size));
+    ::new (header) FrameHeader{Registry::Instance().Allocated(site, size),
+                               Clock::now().time_since_epoch().count(), false};
+    return header + 1;
+}
+
+void DeallocateProfiledFrame(void* frame, size_t size) noexcept {
+    auto header = GetHeader(frame);
+    auto lifetime = Clock::now().time_since_epoch() - Clock::duration(header->start);
+    Registry::Instance().Released(header->site, lifetime, header->awaited);
+    DeallocateFrame(header, sizeof(FrameHeader) + size);
+}
+
+// Relies on the coroutine frame starting at the allocated address,
+// which holds for both GCC and Clang.
+void MarkFrameAwaited(void* frame) noexcept {
+    GetHeader(frame)->awaited = true;
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<FrameProfileEntry> GetFrameProfile() {
+    return detail::Registry::Instance().Snapshot();
+}
+
+void DumpFrameProfile(std::ostream& out) {
+    auto entries = GetFrameProfile();
+    if (entries.empty()) {
+        return;
+    }
+
+    out << "Coroutine frames (lifetimes: <1us <10us <100us <1ms <10ms <100ms <1s >=1s)\n";
+    for (const auto& entry : entries) {
+        out << std::setw(8) << entry.frame_size << " B" << std::setw(10) << entry.allocations
+            << " allocs" << std::setw(8) << entry.peak_live << " peak" << std::setw(10)
+            << entry.elidable << " elidable  [";
+        for (size_t bucket = 0; bucket < kFrameLifetimeBuckets; ++bucket) {
+            out << (bucket ? " " : "") << entry.lifetimes[bucket];
+        }
+        out << "]  " << entry.function << '\n';
+    }
+    out.flush();
+}
+
+}  // namespace coro
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame profiler
+////////////////////////////////////////////////////////////////////////////////
+
+// Frames of AsyncTask coroutines are recorded when the code is compiled with
+// CORO_FRAME_PROFILER defined (the CMake option of the same name). The define
+// must be the same for every translation unit. Without it the profile is empty.
+//
+// The report is written to the standard error at exit, if anything was recorded.
+
+/// Lifetime buckets are decades: <1us, <10us, ..., <1s, >=1s.
+inline constexpr size_t kFrameLifetimeBuckets = 8;
+
+/// Frames allocated by a single coroutine function.
+struct FrameProfileEntry {
+    /// Demangled name of the coroutine. Without a dynamic symbol (executables
+    /// should be linked with -rdynamic) `object+0xoffset` for addr2line,
+    /// or the bare address if not even the object is known.
+    std::string function;
+    /// Frame size requested by the compiler.
+    size_t frame_size = 0;
+    size_t allocations = 0;
+    size_t live = 0;
+    size_t peak_live = 0;
+    /// Frames that were awaited and destroyed inside the awaiting coroutine,
+    /// so the compiler could have elided their allocation (HALO), but did not.
+    size_t elidable = 0;
+    std::array<size_t, kFrameLifetimeBuckets> lifetimes{};
+};
+
+/// Snapshot of all the threads, sorted by allocation count.
+std::vector<FrameProfileEntry> GetFrameProfile();
+
+void DumpFrameProfile(std::ostream& out);
+
+namespace detail {
+
+/// Allocates a pooled frame behind a header which refers to `site`,
+/// the return address inside the coroutine that requested the frame.
+void* AllocateProfiledFrame(size_t size, const void* site);
+void DeallocateProfiledFrame(void* frame, size_t size) noexcept;
+
+/// Marks the frame as destroyed by the coroutine that awaited it.
+void MarkFrameAwaited(void* frame) noexcept;
+
+}  // namespace detail
+
+}  // namespace coro
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stackless/frame_pool.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Class declarations
+////////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class Generator;
+
+namespace detail {
+
+template <class T>
+class GeneratorPromise;
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+// Methods declarations
+////////////////////////////////////////////////////////////////////////////////
+
+/// Lazy synchronous sequence, produced by a coroutine with `co_yield`.
+///
+/// Yielded values are not copied: the generator refers to the object passed to
+/// `co_yield` until the producer is resumed, so a value may live in the
+/// producer frame. Use `Generator<const T>` to yield read-only references.
+///
+///   for (auto& row : ReadRows()) { ... }
+template <class T>
+class Generator {
+public:
+    /// Define promise type for compiler.
+    using promise_type = detail::GeneratorPromise<T>;
+
+    class Sentinel {};
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::remove_cv_t<T>;
+        using reference = T&;
+        using pointer = T*;
+
+        Iterator() noexcept = default;
+
+        reference operator*() const noexcept {
+            return *handle_.promise().GetValue();
+        }
+
+        pointer operator->() const noexcept {
+            return handle_.promise().GetValue();
+        }
+
+        Iterator& operator++() {
+            handle_.resume();
+            handle_.promise().RethrowIfFailed();
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        friend bool operator==(const Iterator& it, Sentinel) noexcept {
+            return it.handle_.done();
+        }
+
+    private:
+        friend Generator;
+
+        explicit Iterator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {
+        }
+
+        std::coroutine_handle<promise_type> handle_{};
+    };
+
+public:
+    /// Default-constructable.
+    Generator() noexcept = default;
+
+    /// Not copyable.
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    /// Movable.
+    Generator(Generator&& other) noexcept : handle_(std::exchange(other.handle_, {})) {
+    }
+
+    Generator& operator=(Generator&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    /// Checks whether this generator holds coroutine.
+    bool IsValid() const noexcept {
+        return handle_ != nullptr;
+    }
+
+    /// Starts the producer and runs it up to the first value.
+    /// May be called once.
+    Iterator begin() {  // NOLINT
+        handle_.resume();
+        handle_.promise().RethrowIfFailed();
+        return Iterator(handle_);
+    }
+
+    Sentinel end() noexcept {  // NOLINT
+        return {};
+    }
+
+    ~Generator() noexcept {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {
+    }
+
+    friend promise_type;
+
+    std::coroutine_handle<promise_type> handle_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+template <class T>
+class GeneratorPromise {
+public:
+    using ValueType = std::remove_reference_t<T>;
+
+    // Frames are recycled through the per-thread frame pool
+    static void* operator new(std::size_t size) {
+        return AllocateFrame(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept {
+        DeallocateFrame(frame, size);
+    }
+
+    Generator<T> get_return_object() noexcept {
+        return Generator<T>(std::coroutine_handle<GeneratorPromise>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    std::suspend_always final_suspend() noexcept {
+        return {};
+    }
+
+    // The yielded object outlives the suspension, only its address is kept.
+    std::suspend_always yield_value(ValueType& value) noexcept {
+        value_ = std::addressof(value);
+        return {};
+    }
+
+    std::suspend_always yield_value(ValueType&& value) noexcept {
+        value_ = std::addressof(value);
+        return {};
+    }
+
+    void return_void() noexcept {
+    }
+
+    void unhandled_exception() noexcept {
+        exception_ = std::current_exception();
+    }
+
+    // Generators are synchronous, the producer can not await anything.
+    template <class U>
+    std::suspend_never await_transform(U&&) = delete;
+
+    ValueType* GetValue() const noexcept {
+        return value_;
+    }
+
+    void RethrowIfFailed() {
+        if (exception_) {
+            std::rethrow_exception(std::exchange(exception_, {}));
+        }
+    }
+
+private:
+    ValueType* value_ = nullptr;
+    std::exception_ptr exception_{};
+};
+
+}  // namespace detail
+
+}  // namespace coro
@@ -5,53 +5,175 @@
 
 #include <sys/mman.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
 namespace lines {
 
 namespace {
 
-size_t PageSize() {
+size_t QueryPageSize() {
     auto result = sysconf(_SC_PAGESIZE);
     ASSERT(result >= 0);
     return static_cast<size_t>(result);
 }
 
-const size_t kPageSize = PageSize();                        // Usually 4 KiB.
-const size_t kStackSize = (1ul << 11) * kPageSize;          // Usually 8 MiB.
-const size_t kAllocationSize = 2 * kPageSize + kStackSize;  // Protect stack from both sides.
+const size_t kPageSize = QueryPageSize();  // Usually 4 KiB.
+
+// Usually 8 MiB.
+std::atomic<size_t> default_size{(1ul << 11) * kPageSize};
+// The control block and the thread local storage of a fiber take two pages
+const size_t kMinSize = 4 * kPageSize;
+
+// Protect stack from both sides.
+size_t AllocationSize(size_t size) {
+    return 2 * kPageSize + size;
+}
 
 void ProtectPage(void* address) {
     int ret = mprotect(address, kPageSize, PROT_NONE);
     ASSERT(ret == 0);
 }
 
+// Releases that find the watermark intact before one releases anyway
+constexpr size_t kSweepPeriod = 16;
+constexpr uint64_t kWatermark = 0x6b72616d6b617473;  // "stakmark"
+
+void Paint(std::byte* page) {
+    std::fill_n(reinterpret_cast<uint64_t*>(page), kPageSize / sizeof(uint64_t), kWatermark);
+}
+
+bool IsPainted(const std::byte* page) {
+    auto words = reinterpret_cast<const uint64_t*>(page);
+    return std::all_of(words, words + kPageSize / sizeof(uint64_t),
+                       [](uint64_t word) { return word == kWatermark; });
+}
+
 }  // namespace
 
-Stack::Stack() {
-    allocation_ =
-        mmap(nullptr, kAllocationSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    ASSERT(allocation_ != nullptr);
+Stack::Stack(size_t size) : size_(RoundSize(size)) {
+    allocation_ = mmap(nullptr, AllocationSize(size_), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(allocation_ != MAP_FAILED);
     ProtectPage(allocation_);
-    ProtectPage(static_cast<std::byte*>(allocation_) + kPageSize + kStackSize);
+    ProtectPage(static_cast<std::byte*>(allocation_) + kPageSize + size_);
 }
 
 Stack::~Stack() {
     if (allocation_) {
-        int ret = munmap(allocation_, kAllocationSize);
+        int ret = munmap(allocation_, AllocationSize(size_));
         ASSERT(ret == 0);
     }
 }
 
 Stack::Stack(Stack&& other) {
     std::swap(other.allocation_, allocation_);
+    std::swap(other.size_, size_);
+    std::swap(other.watermark_, watermark_);
+    std::swap(other.untouched_releases_, untouched_releases_);
 }
 
 Stack& Stack::operator=(Stack&& other) {
     std::swap(allocation_, other.allocation_);
+    std::swap(size_, other.size_);
+    std::swap(watermark_, other.watermark_);
+    std::swap(untouched_releases_, other.untouched_releases_);
     return *this;
 }
 
+// One mapping with no access, opened stack by stack: a syscall per stack
+// instead of three, the guard pages stay between the stacks.
+std::vector<Stack> Stack::AllocateMany(size_t count, size_t size) {
+    std::vector<Stack> stacks;
+    if (count == 0) {
+        return stacks;
+    }
+
+    size = RoundSize(size);
+    auto region = static_cast<std::byte*>(mmap(nullptr, count * AllocationSize(size), PROT_NONE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT(region != MAP_FAILED);
+
+    stacks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto allocation = region + i * AllocationSize(size);
+        int ret = mprotect(allocation + kPageSize, size, PROT_READ | PROT_WRITE);
+        ASSERT(ret == 0);
+        stacks.push_back(Stack(allocation, size));
+    }
+    return stacks;
+}
+
+size_t Stack::MeasureDepth() {
+    auto view = GetStackView();
+    std::vector<unsigned char> resident(size_ / kPageSize);
+    int ret = mincore(view.data(), view.size(), resident.data());
+    ASSERT(ret == 0);
+
+    auto deepest = std::find_if(resident.begin(), resident.end(),
+                                [](unsigned char page) { return page & 1; });
+    return (resident.end() - deepest) * kPageSize;
+}
+
+void Stack::ReleaseMemory(size_t keep) {
+    if (keep >= size_) {
+        return;
+    }
+
+    // Stacks grow down: the cold part is at the bottom, rounded to pages
+    size_t cold = (size_ - keep) & ~(kPageSize - 1);
+    int ret = madvise(GetStackView().data(), cold, MADV_DONTNEED);
+    ASSERT(ret == 0);
+    watermark_ = nullptr;
+}
+
+void Stack::ReleaseTouchedMemory(size_t keep) {
+    size_t cold = keep < size_ ? (size_ - keep) & ~(kPageSize - 1) : 0;
+    if (cold == 0) {
+        return;
+    }
+
+    auto view = GetStackView();
+    auto watermark = view.data() + cold - kPageSize;
+    if (watermark == watermark_ && untouched_releases_ + 1 < kSweepPeriod &&
+        IsPainted(watermark)) {
+        ++untouched_releases_;
+        return;
+    }
+
+    if (cold > kPageSize) {
+        int ret = madvise(view.data(), cold - kPageSize, MADV_DONTNEED);
+        ASSERT(ret == 0);
+    }
+    Paint(watermark);
+    watermark_ = watermark;
+    untouched_releases_ = 0;
+}
+
 std::span<std::byte> Stack::GetStackView() {
-    return {static_cast<std::byte*>(allocation_) + kPageSize, kStackSize};
+    return {static_cast<std::byte*>(allocation_) + kPageSize, size_};
+}
+
+void Stack::SetDefaultSize(size_t size) {
+    ASSERT(size > 0);
+    default_size.store(RoundSize(size), std::memory_order::relaxed);
+}
+
+size_t Stack::GetDefaultSize() {
+    return default_size.load(std::memory_order::relaxed);
+}
+
+size_t Stack::PageSize() {
+    return kPageSize;
+}
+
+size_t Stack::RoundSize(size_t size) {
+    if (size == 0) {
+        return GetDefaultSize();
+    }
+    return std::max(kMinSize, (size + kPageSize - 1) & ~(kPageSize - 1));
 }
 
 }  // namespace lines
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <cstddef>
 #include <span>
+#include <vector>
 
 namespace lines {
 
 class Stack {
 public:
-    Stack();
+    // Sizes are rounded up to whole pages, 16 KiB at least.
+    // Zero means the default size.
+    explicit Stack(size_t size = 0);
     ~Stack();
 
     Stack(const Stack&) = delete;
@@ -17,8 +21,46 @@ public:
 
     std::span<std::byte> GetStackView();
 
+    size_t GetSize() const {
+        return size_;
+    }
+
+    // How deep the stack has been touched since it was mapped or its memory
+    // released, at page granularity: the extent of its resident pages.
+    size_t MeasureDepth();
+
+    // Gives the pages of the stack back to the kernel, except for the
+    // top `keep` bytes that a new fiber touches first.
+    void ReleaseMemory(size_t keep);
+
+    // Same, but only if the stack was touched below the top `keep` bytes
+    // since the last release, which costs no syscall to tell: the top page
+    // below them stays resident, painted with a watermark. A frame larger
+    // than a page may jump over the watermark, so every few releases
+    // give the memory back regardless.
+    void ReleaseTouchedMemory(size_t keep);
+
+    // Maps `count` stacks at once. Each stack is unmapped on its own.
+    static std::vector<Stack> AllocateMany(size_t count, size_t size = 0);
+
+    // The size of stacks created without one, process-wide. 8 MiB by default.
+    static void SetDefaultSize(size_t size);
+    static size_t GetDefaultSize();
+
+    static size_t PageSize();
+
+private:
+    Stack(void* allocation, size_t size) : allocation_(allocation), size_(size) {
+    }
+
+    static size_t RoundSize(size_t size);
+
 private:
     void* allocation_{};
+    size_t size_ = 0;
+    // Painted after the last release, null if the paint may be gone
+    std::byte* watermark_ = nullptr;
+    size_t untouched_releases_ = 0;
 };
 
 }  // namespace lines
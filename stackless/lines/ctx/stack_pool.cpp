@@ -0,0 +1,86 @@
+#include <lines/ctx/stack_pool.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace lines {
+
+Stack StackPool::Allocate(size_t size) {
+    size = ClassSize(size);
+    auto& stacks = Class(size);
+    if (stacks.empty()) {
+        return Stack(size);
+    }
+
+    auto stack = std::move(stacks.back());
+    stacks.pop_back();
+    return stack;
+}
+
+std::vector<Stack> StackPool::AllocateMany(size_t count, size_t size) {
+    size = ClassSize(size);
+    auto& pooled = Class(size);
+
+    size_t reused = std::min(count, pooled.size());
+    auto stacks = Stack::AllocateMany(count - reused, size);
+    for (size_t i = 0; i < reused; ++i) {
+        stacks.push_back(std::move(pooled.back()));
+        pooled.pop_back();
+    }
+    return stacks;
+}
+
+void StackPool::Release(Stack stack) {
+    // Stacks mapped around the pool do not fit a class
+    if (stack.GetSize() != ClassSize(stack.GetSize())) {
+        return;
+    }
+
+    auto& stacks = Class(stack.GetSize());
+    if (stacks.size() >= limit_) {
+        return;
+    }
+
+    stack.ReleaseTouchedMemory(hot_size_);
+    stacks.push_back(std::move(stack));
+}
+
+void StackPool::SetLimit(size_t limit) {
+    limit_ = limit;
+    for (auto& stacks : classes_) {
+        if (stacks.size() > limit_) {
+            stacks.erase(stacks.begin() + limit_, stacks.end());
+        }
+    }
+}
+
+void StackPool::SetHotSize(size_t bytes) {
+    hot_size_ = bytes;
+}
+
+size_t StackPool::Size() const {
+    size_t size = 0;
+    for (auto& stacks : classes_) {
+        size += stacks.size();
+    }
+    return size;
+}
+
+size_t StackPool::ClassSize(size_t size) {
+    if (size == 0) {
+        size = Stack::GetDefaultSize();
+    }
+    auto page = Stack::PageSize();
+    return page * std::bit_ceil((size + page - 1) / page);
+}
+
+std::vector<Stack>& StackPool::Class(size_t size) {
+    auto index = std::bit_width(size / Stack::PageSize()) - 1;
+    if (classes_.size() <= index) {
+        classes_.resize(index + 1);
+    }
+    return classes_[index];
+}
+
+}  // namespace lines
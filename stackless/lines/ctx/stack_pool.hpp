@@ -0,0 +1,57 @@
+#pragma once
+
+#include <lines/ctx/stack.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace lines {
+
+// Stacks of finished fibers kept for reuse, guard pages and all, so a
+// short-lived fiber costs no syscalls: a stack is only madvised after its
+// fiber went deeper than the hot top, see Stack::ReleaseTouchedMemory().
+// Stacks are pooled by size classes, powers of two of pages: up to the limit
+// (the high watermark) stacks of each class are kept, the rest are unmapped.
+class StackPool {
+public:
+    static constexpr size_t kDefaultLimit = 64;
+    static constexpr size_t kDefaultHotSize = 64 * 1024;
+
+    StackPool() = default;
+
+    StackPool(const StackPool&) = delete;
+    StackPool& operator=(const StackPool&) = delete;
+
+    // A stack of at least `size` bytes, zero means the default size.
+    Stack Allocate(size_t size = 0);
+    std::vector<Stack> AllocateMany(size_t count, size_t size = 0);
+
+    void Release(Stack stack);
+
+    // Unmaps the stacks above the new limit, zero disables the pool.
+    void SetLimit(size_t limit);
+    size_t GetLimit() const {
+        return limit_;
+    }
+
+    // The top of a released stack that stays resident. Deeper pages, once
+    // touched, are given back to the kernel and read as zeroes on the next use.
+    void SetHotSize(size_t bytes);
+
+    // Stacks kept in all the classes.
+    size_t Size() const;
+
+    // The size of the stacks allocated for `size`.
+    static size_t ClassSize(size_t size);
+
+private:
+    std::vector<Stack>& Class(size_t size);
+
+private:
+    // By the log of the size in pages
+    std::vector<std::vector<Stack>> classes_;
+    size_t limit_ = kDefaultLimit;
+    size_t hot_size_ = kDefaultHotSize;
+};
+
+}  // namespace lines
@@ -15,6 +15,12 @@ void Run() {
 
 }  // namespace detail
 
+void SetDefaultStackSize([[maybe_unused]] size_t size) {
+#ifndef LINES_THREADS
+    Stack::SetDefaultSize(size);
+#endif
+}
+
 void Yield() {
 #ifndef LINES_THREADS
     auto& scheduler = Scheduler::This();
@@ -24,4 +30,19 @@ void Yield() {
 #endif
 }
 
+bool YieldAwaitable::await_ready() noexcept {
+#ifndef LINES_THREADS
+    return false;
+#else
+    std::this_thread::yield();
+    return true;
+#endif
+}
+
+void YieldAwaitable::await_suspend([[maybe_unused]] std::coroutine_handle<> handle) {
+#ifndef LINES_THREADS
+    Scheduler::This().Schedule(handle);
+#endif
+}
+
 }  // namespace lines
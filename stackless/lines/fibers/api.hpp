@@ -1,7 +1,11 @@
 #pragma once
 
+#include <lines/fibers/group.hpp>
 #include <lines/fibers/handle.hpp>
 
+#include <coroutine>
+#include <cstddef>
+#include <source_location>
 #include <utility>
 
 namespace lines {
@@ -12,17 +16,78 @@ void Run();
 
 }  // namespace detail
 
+// `site` names the fiber in the stack profile, see GetStackProfile().
 template <class F>
-auto Spawn(F&& f) {
+auto Spawn(F&& f, [[maybe_unused]] std::source_location site = std::source_location::current()) {
+#ifndef LINES_THREADS
+    return Handle(std::forward<F>(f), site);
+#else
+    return Handle(std::forward<F>(f));
+#endif
+}
+
+// Spawns a fiber that shares the processor time of `group`.
+template <class F>
+auto Spawn(FiberGroup& group, F&& f,
+           [[maybe_unused]] std::source_location site = std::source_location::current()) {
+#ifndef LINES_THREADS
+    return Handle(group, std::forward<F>(f), site);
+#else
+    return Handle(std::forward<F>(f));
+#endif
+}
+
+template <class F>
+auto Spawn(const SpawnOptions& options, F&& f,
+           [[maybe_unused]] std::source_location site = std::source_location::current()) {
+#ifndef LINES_THREADS
+    return Handle(options, std::forward<F>(f), site);
+#else
     return Handle(std::forward<F>(f));
+#endif
+}
+
+// Spawns `count` fibers running `f(index)` at once, see HandleGroup.
+template <class F>
+auto SpawnMany(size_t count, F&& f, std::source_location site = std::source_location::current()) {
+    return HandleGroup(count, std::forward<F>(f), site);
+}
+
+template <class F>
+auto SpawnMany(const SpawnOptions& options, size_t count, F&& f,
+               std::source_location site = std::source_location::current()) {
+#ifndef LINES_THREADS
+    return HandleGroup(options, count, std::forward<F>(f), site);
+#else
+    return HandleGroup(count, std::forward<F>(f), site);
+#endif
+}
+
+template <class F>
+auto SpawnMany(FiberGroup& group, size_t count, F&& f,
+               std::source_location site = std::source_location::current()) {
+    return SpawnMany(SpawnOptions{.group = &group}, count, std::forward<F>(f), site);
 }
 
+// The stack size of fibers spawned without one, process-wide. 8 MiB by default.
+void SetDefaultStackSize(size_t size);
+
+// Returns at once if nothing else wants the thread.
 void Yield();
 
+// Reschedules the awaiting coroutine: `co_await lines::YieldAwaitable{};`.
+struct YieldAwaitable {
+    bool await_ready() noexcept;
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() noexcept {
+    }
+};
+
 template <class F>
-void SchedulerRun(F&& f, size_t num_runs = 10) {
+void SchedulerRun(F&& f, size_t num_runs = 10,
+                  std::source_location site = std::source_location::current()) {
     for (size_t run = 0; run < num_runs; ++run) {
-        auto handle = Spawn(f);
+        auto handle = Spawn(f, site);
 
 #ifndef LINES_THREADS
         detail::Run();
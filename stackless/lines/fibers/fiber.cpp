@@ -1,56 +1,127 @@
 #include <lines/fibers/fiber.hpp>
 #include <lines/fibers/scheduler.hpp>
 #include <lines/fibers/handle.hpp>
+#include <lines/fibers/pool.hpp>
+#include <lines/fibers/stats.hpp>
 
 #include <libassert/assert.hpp>
 
-namespace lines {
+#include <algorithm>
 
-constexpr size_t kStorageSize = 1 << 12;
+namespace lines {
 
 Fiber::~Fiber() {
-    if (waiter_) {
-        waiter_->state_ = Fiber::State::Runnable;
-        Scheduler::This().Schedule(waiter_);
+    ASSERT(joiners_.Empty());
+}
+
+void Fiber::Destroy(Fiber* fiber) {
+    // The stack holds the fiber itself, so it outlives the destructor
+    auto stack = std::move(fiber->stack_);
+    fiber->~Fiber();
+    Scheduler::This().GetStackPool().Release(std::move(stack));
+}
+
+void Fiber::Register() {
+    pool_ = Scheduler::This().GetPool();
+    if (pool_) {
+        pool_->FiberStarted();
+    }
+
+    // A pooled stack may still hold pages an earlier fiber dirtied,
+    // the profile measures this fiber alone
+    if (IsStackProfilerEnabled()) {
+        stack_.ReleaseMemory(ReservedSize());
     }
 }
 
 void Fiber::Run() {
+    Scheduler::This().SettleLeft();
     state_ = State::Running;
 
     try {
-        // Allocate thread local storage on fiber's stack.
-        alignas(16) std::array<std::byte, kStorageSize> tls{};
-        tls_view_ = tls;
         routine_();
     } catch (...) {
     }
 
     state_ = State::Dead;
 
-    if (handle_) {
-        handle_->detach();
-    }
-
     Scheduler::This().Schedule(this);
 
     UNREACHABLE();
 }
 
-void Fiber::Park(Fiber* fiber) {
-    ASSERT(!waiter_);
-    waiter_ = fiber;
+bool Fiber::Exit() {
+    ASSERT(state_ == State::Dead);
+    finished_.store(true, std::memory_order::seq_cst);
+    joiners_.WakeAll();
+
+    if (pool_) {
+        pool_->FiberFinished();
+    }
+    return Release();
+}
+
+bool Fiber::Release() {
+    return refs_.fetch_sub(1, std::memory_order::acq_rel) == 1;
+}
+
+bool Fiber::IsFinished() const {
+    return finished_.load(std::memory_order::seq_cst);
+}
+
+WaitQueue& Fiber::GetJoiners() {
+    return joiners_;
+}
+
+FiberGroup* Fiber::GetGroup() const {
+    return group_;
+}
+
+std::chrono::nanoseconds Fiber::GetRuntime() const {
+    return runtime_;
+}
+
+std::chrono::nanoseconds Fiber::GetMaxSlice() const {
+    return max_slice_;
+}
+
+void Fiber::Account(std::chrono::nanoseconds slice) {
+    runtime_ += slice;
+    max_slice_ = std::max(max_slice_, slice);
 }
 
 Fiber* Fiber::This() {
     return Scheduler::This().Running();
 }
 
+namespace {
+
+// The control block and the storage come on top of the requested stack
+size_t MappingSize(size_t size) {
+    return size == 0 ? 0 : size + Fiber::ReservedSize();
+}
+
+}  // namespace
+
+Stack Fiber::AllocateStack(size_t size) {
+    return Scheduler::This().GetStackPool().Allocate(MappingSize(size));
+}
+
+std::vector<Stack> Fiber::AllocateStacks(size_t count, size_t size) {
+    return Scheduler::This().GetStackPool().AllocateMany(count, MappingSize(size));
+}
+
 Context& Fiber::GetContext() {
     return ctx_;
 }
 
 std::span<std::byte> Fiber::GetTLSView() {
+    if (tls_view_.empty()) {
+        // A pooled stack keeps the storage of its previous fiber
+        auto storage = reinterpret_cast<std::byte*>(this) - kStorageSize;
+        std::fill(storage, storage + kStorageSize, std::byte{});
+        tls_view_ = {storage, kStorageSize};
+    }
     return tls_view_;
 }
 
@@ -4,11 +4,18 @@
 #include <lines/ctx/ctx.hpp>
 #include <lines/ctx/stack.hpp>
 #include <lines/ctx/trampoline.hpp>
-#include <lines/sync/awaitable.hpp>
+#include <lines/sync/wait_queue.hpp>
 
 #include <function2/function2.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <source_location>
+#include <span>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #ifdef LINES_THREADS
 
@@ -28,7 +35,13 @@ using Routine = fu2::unique_function<void()>;
 class Handle;
 #endif
 
-class Fiber : public IntrusiveNode<Fiber>, public ITrampoline, public IAwaitable {
+class SchedulerPool;
+class FiberGroup;
+
+// A fiber lives in a single mapping: the control block at the top of its
+// stack, the thread local storage right below it, then the stack proper.
+// The fields the scheduler touches on every switch share the first cache line.
+class alignas(64) Fiber : public IntrusiveNode<Fiber>, public ITrampoline {
 public:
     enum class State {
         Runnable,
@@ -37,16 +50,50 @@ public:
         Suspended,
     };
 
+    static constexpr size_t kStorageSize = 1 << 12;
+
 public:
+    // A fiber with a handle is released by both the handle and the scheduler.
+    // `site` is where the fiber was spawned, see GetStackProfile().
+    template <class F>
+    static Fiber* Create(F&& f, Handle* handle, FiberGroup* group = nullptr,
+                         std::source_location site = std::source_location::current()) {
+        return Create(std::forward<F>(f), AllocateStack(), handle, group, site);
+    }
+
+    // Runs on a stack allocated in advance, see Stack::AllocateMany.
     template <class F>
-    explicit Fiber(F&& f, Handle* handle) : routine_(std::forward<F>(f)), handle_(handle) {
-        ctx_.Setup(stack_.GetStackView(), this);
+    static Fiber* Create(F&& f, Stack stack, Handle* handle, FiberGroup* group = nullptr,
+                         std::source_location site = std::source_location::current()) {
+        auto view = stack.GetStackView();
+        void* block = view.data() + view.size() - sizeof(Fiber);
+        return new (block) Fiber(std::forward<F>(f), std::move(stack), handle, group, site);
     }
 
+    // Destroys the fiber and gives its stack back to the stack pool.
+    static void Destroy(Fiber* fiber);
+
     ~Fiber() override;
 
     void Run() final;
-    void Park(Fiber* fiber) final;
+
+    // Called by the scheduler once the dead fiber has left its stack.
+    // Wakes the joiners, returns true if the fiber should be destroyed.
+    bool Exit();
+
+    // Drops a reference, returns true if the fiber should be destroyed.
+    bool Release();
+
+    bool IsFinished() const;
+    WaitQueue& GetJoiners();
+
+    // Null for the scheduler's default group.
+    FiberGroup* GetGroup() const;
+
+    // Time the fiber has run, not counting the current slice.
+    std::chrono::nanoseconds GetRuntime() const;
+    // The longest the fiber has run without switching to the scheduler.
+    std::chrono::nanoseconds GetMaxSlice() const;
 
     Context& GetContext();
     std::span<std::byte> GetTLSView();
@@ -56,21 +103,56 @@ public:
 
     static Fiber* This();
 
+    // Stacks from the stack pool of the running scheduler with at least `size`
+    // bytes left to the routine below ReservedSize(). Zero means a mapping of
+    // the default size, reserved top included.
+    static Stack AllocateStack(size_t size = 0);
+    static std::vector<Stack> AllocateStacks(size_t count, size_t size = 0);
+
+    // The top of the stack taken by the control block and the thread local
+    // storage, the rest is left to the routine.
+    static constexpr size_t ReservedSize() {
+        return sizeof(Fiber) + kStorageSize;
+    }
+
 private:
-    Routine routine_;
-    Stack stack_;
-    Context ctx_;
+    friend class Scheduler;
 
-    Handle* handle_{};
-    Fiber* waiter_{};
-    State state_ = State::Runnable;
+    template <class F>
+    Fiber(F&& f, Stack stack, Handle* handle, FiberGroup* group, std::source_location site)
+        : stack_(std::move(stack)),
+          routine_(std::forward<F>(f)),
+          refs_(handle ? 2 : 1),
+          group_(group),
+          site_(site) {
+        Register();
+        auto view = stack_.GetStackView();
+        ctx_.Setup(view.first(view.size() - ReservedSize()), this);
+    }
 
-    std::span<std::byte> tls_view_{};
+    void Register();
+    void Account(std::chrono::nanoseconds slice);
 
-#ifndef LINES_THREADS
 private:
-    friend class Handle;
-#endif
+    // Hot: with the intrusive links, switched and queued by the scheduler
+    Context ctx_;
+    State state_ = State::Runnable;
+
+    Stack stack_;
+    Routine routine_;
+
+    std::atomic<int> refs_;
+    std::atomic<bool> finished_{false};
+    WaitQueue joiners_;
+    SchedulerPool* pool_ = nullptr;
+    FiberGroup* group_;
+    std::chrono::nanoseconds runtime_{};
+    std::chrono::nanoseconds max_slice_{};
+    // Keys the stack profile
+    std::source_location site_;
+
+    // Carved out below the control block and zeroed on first use
+    std::span<std::byte> tls_view_{};
 };
 
 }  // namespace lines
@@ -0,0 +1,20 @@
+#include <lines/fibers/group.hpp>
+
+#include <libassert/assert.hpp>
+
+namespace lines {
+
+FiberGroup::FiberGroup(uint32_t weight) : weight_(weight) {
+    ASSERT(weight > 0);
+}
+
+FiberGroup::~FiberGroup() {
+    ASSERT(heap_index_ == kNotInHeap, "Group destroyed with runnable fibers");
+}
+
+void FiberGroup::Account(std::chrono::nanoseconds runtime) {
+    runtime_ += runtime;
+    vruntime_ += static_cast<uint64_t>(runtime.count()) * kDefaultWeight / weight_;
+}
+
+}  // namespace lines
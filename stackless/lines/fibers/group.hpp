@@ -0,0 +1,60 @@
+#pragma once
+
+#include <lines/fibers/run_queue.hpp>
+#include <lines/util/indexed_heap.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace lines {
+
+// Fibers that share the processor as one. Runnable groups get processor
+// time in proportion to their weights, like CFS: the scheduler runs the group
+// with the smallest virtual runtime, which grows by the time its fibers run
+// divided by the weight. Within a group fibers follow the scheduler's RunPolicy.
+//
+// A group must outlive its fibers. Groups are ignored by SchedulerPool
+// workers and under LINES_THREADS.
+class FiberGroup {
+public:
+    static constexpr uint32_t kDefaultWeight = 1024;
+
+    explicit FiberGroup(uint32_t weight = kDefaultWeight);
+
+    FiberGroup(const FiberGroup&) = delete;
+    FiberGroup& operator=(const FiberGroup&) = delete;
+
+    ~FiberGroup();
+
+    uint32_t GetWeight() const {
+        return weight_;
+    }
+
+    // Time the fibers of the group have run.
+    std::chrono::nanoseconds GetRuntime() const {
+        return runtime_;
+    }
+
+    bool operator<(const FiberGroup& other) const {
+        return vruntime_ < other.vruntime_;
+    }
+
+private:
+    friend class Scheduler;
+    friend class IndexedHeap<FiberGroup>;
+
+    void Account(std::chrono::nanoseconds runtime);
+
+private:
+    uint32_t weight_;
+    std::chrono::nanoseconds runtime_{};
+    // Nanoseconds scaled by kDefaultWeight / weight
+    uint64_t vruntime_ = 0;
+
+    // Non-empty exactly while the group is queued in the scheduler
+    RunQueue fibers_;
+    size_t heap_index_ = kNotInHeap;
+};
+
+}  // namespace lines
@@ -9,49 +9,73 @@ namespace lines {
 
 Handle::Handle(Handle&& other) {
     std::swap(fiber_, other.fiber_);
-    if (fiber_) {
-        fiber_->handle_ = this;
-    }
 }
 
 Handle& Handle::operator=(Handle&& other) {
     std::swap(fiber_, other.fiber_);
-    if (fiber_) {
-        fiber_->handle_ = this;
-    }
-    if (other.fiber_) {
-        other.fiber_->handle_ = &other;
-    }
     return *this;
 }
 
 Handle::~Handle() {
     ASSERT(!joinable());
+    Release();
 }
 
 void Handle::Schedule() {
     auto& scheduler = Scheduler::This();
-    scheduler.Schedule(fiber_);
+    scheduler.Spawn(fiber_);
 }
 
-void Handle::detach() {
-    if (fiber_) {
-        fiber_->handle_ = nullptr;
-        fiber_ = nullptr;
+void Handle::Release() {
+    if (fiber_ && fiber_->Release()) {
+        Fiber::Destroy(fiber_);
     }
+    fiber_ = nullptr;
+}
+
+void Handle::detach() {
+    Release();
 }
 
 void Handle::join() {
-    if (fiber_) {
-        auto& scheduler = Scheduler::This();
-        scheduler.Suspend(fiber_);
+    if (!fiber_) {
+        return;
+    }
+
+    auto& joiners = fiber_->GetJoiners();
+    while (true) {
+        auto epoch = joiners.Epoch();
+        if (fiber_->IsFinished()) {
+            break;
+        }
+        joiners.Wait(epoch);
     }
+    Release();
 }
 
 bool Handle::joinable() {
-    return fiber_;
+    return fiber_ && !fiber_->IsFinished();
+}
+
+void HandleGroup::Schedule(FiberQueue& fibers) {
+    auto& scheduler = Scheduler::This();
+    scheduler.Spawn(fibers);
 }
 
 #endif
 
+void HandleGroup::JoinAll() {
+    for (auto& handle : handles_) {
+        handle.join();
+    }
+    handles_.clear();
+}
+
+void HandleGroup::DetachAll() {
+    for (auto& handle : handles_) {
+        handle.detach();
+    }
+    handles_.clear();
+}
+
 }  // namespace lines
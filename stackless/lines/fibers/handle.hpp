@@ -1,6 +1,26 @@
 #pragma once
 
+#include <cstddef>
+#include <source_location>
 #include <thread>
+#include <utility>
+#include <vector>
+
+namespace lines {
+
+class FiberGroup;
+
+struct SpawnOptions {
+    // The stack left to the routine: the mapping adds the fiber's control
+    // block and local storage, then is rounded up to a power of two of pages.
+    // Zero means the default size, see SetDefaultStackSize(). Ignored under
+    // LINES_THREADS.
+    size_t stack_size = 0;
+    // Null for the scheduler's default group.
+    FiberGroup* group = nullptr;
+};
+
+}  // namespace lines
 
 #ifdef LINES_THREADS
 
@@ -13,15 +33,34 @@ using Handle = std::thread;
 #else
 
 #include <lines/fibers/fiber.hpp>
+#include <lines/fibers/group.hpp>
+#include <lines/fibers/queue.hpp>
 
 namespace lines {
 
+// The fiber may finish on another worker, so its memory is kept
+// until it has finished and the handle is released.
 class Handle {
 public:
     Handle() = default;
 
     template <class F>
-    explicit Handle(F&& f) : fiber_(new Fiber(std::forward<F>(f), this)) {
+    explicit Handle(F&& f, std::source_location site = std::source_location::current())
+        : fiber_(Fiber::Create(std::forward<F>(f), this, nullptr, site)) {
+        Schedule();
+    }
+
+    template <class F>
+    Handle(FiberGroup& group, F&& f, std::source_location site = std::source_location::current())
+        : fiber_(Fiber::Create(std::forward<F>(f), this, &group, site)) {
+        Schedule();
+    }
+
+    template <class F>
+    Handle(const SpawnOptions& options, F&& f,
+           std::source_location site = std::source_location::current())
+        : fiber_(Fiber::Create(std::forward<F>(f), Fiber::AllocateStack(options.stack_size),
+                               this, options.group, site)) {
         Schedule();
     }
 
@@ -38,7 +77,10 @@ public:
     ~Handle();
 
 private:
+    friend class HandleGroup;
+
     void Schedule();
+    void Release();
 
 private:
     Fiber* fiber_{};
@@ -47,3 +89,69 @@ private:
 }  // namespace lines
 
 #endif
+
+namespace lines {
+
+// Handles of fibers spawned together by SpawnMany. The fibers get their
+// stacks from a single mapping and join the run queue in one splice.
+class HandleGroup {
+public:
+    HandleGroup() = default;
+
+    // Runs `f(index)` for every index in [0, count).
+    template <class F>
+    HandleGroup(size_t count, F&& f,
+                [[maybe_unused]] std::source_location site = std::source_location::current()) {
+#ifndef LINES_THREADS
+        Spawn(count, std::forward<F>(f), SpawnOptions{}, site);
+#else
+        handles_.reserve(count);
+        for (size_t index = 0; index < count; ++index) {
+            handles_.emplace_back([f, index]() mutable { f(index); });
+        }
+#endif
+    }
+
+#ifndef LINES_THREADS
+    template <class F>
+    HandleGroup(const SpawnOptions& options, size_t count, F&& f,
+                std::source_location site = std::source_location::current()) {
+        Spawn(count, std::forward<F>(f), options, site);
+    }
+#endif
+
+    HandleGroup(HandleGroup&&) = default;
+    HandleGroup& operator=(HandleGroup&&) = default;
+
+    size_t Size() const {
+        return handles_.size();
+    }
+
+    void JoinAll();
+    void DetachAll();
+
+private:
+#ifndef LINES_THREADS
+    template <class F>
+    void Spawn(size_t count, F&& f, const SpawnOptions& options, std::source_location site) {
+        auto stacks = Fiber::AllocateStacks(count, options.stack_size);
+        handles_.resize(count);
+
+        FiberQueue fibers;
+        for (size_t index = 0; index < count; ++index) {
+            auto& handle = handles_[index];
+            handle.fiber_ = Fiber::Create([f, index]() mutable { f(index); },
+                                          std::move(stacks[index]), &handle, options.group, site);
+            fibers.Append(handle.fiber_);
+        }
+        Schedule(fibers);
+    }
+
+    static void Schedule(FiberQueue& fibers);
+#endif
+
+private:
+    std::vector<Handle> handles_;
+};
+
+}  // namespace lines
@@ -0,0 +1,47 @@
+#include <lines/fibers/inbox.hpp>
+
+#include <utility>
+
+namespace lines {
+
+Inbox::~Inbox() {
+    auto node = head_.load(std::memory_order::acquire);
+    while (node) {
+        delete std::exchange(node, node->next);
+    }
+}
+
+bool Inbox::Push(Routine routine) {
+    auto node = new Node{std::move(routine)};
+    // The node belongs to the consumer once published, so the old head is kept aside
+    auto head = head_.load(std::memory_order::relaxed);
+    do {
+        node->next = head;
+    } while (!head_.compare_exchange_weak(head, node, std::memory_order::release,
+                                          std::memory_order::relaxed));
+    return head == nullptr;
+}
+
+bool Inbox::Drain() {
+    if (Empty()) {
+        return false;
+    }
+
+    // The stack holds the newest routine first
+    Node* first = nullptr;
+    auto node = head_.exchange(nullptr, std::memory_order::acquire);
+    while (node) {
+        auto next = std::exchange(node->next, first);
+        first = std::exchange(node, next);
+    }
+
+    while (first) {
+        auto next = first->next;
+        first->routine();
+        delete first;
+        first = next;
+    }
+    return true;
+}
+
+}  // namespace lines
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <function2/function2.hpp>
+
+#include <atomic>
+
+namespace lines {
+
+// Routines submitted to a scheduler from other threads. Producers push onto
+// a lock-free stack, the scheduler takes all of them at once and runs them
+// in the order they were pushed.
+class Inbox {
+public:
+    using Routine = fu2::unique_function<void()>;
+
+    Inbox() = default;
+
+    Inbox(const Inbox&) = delete;
+    Inbox& operator=(const Inbox&) = delete;
+
+    ~Inbox();
+
+    // Safe to call from any thread, but not from a signal handler: the node
+    // is allocated. Returns true if the inbox was empty: only then the
+    // consumer has to be woken up.
+    bool Push(Routine routine);
+
+    // Runs the routines pushed so far, returns false if there were none.
+    // Only the owning thread drains.
+    bool Drain();
+
+    bool Empty() const {
+        return head_.load(std::memory_order::relaxed) == nullptr;
+    }
+
+private:
+    struct Node {
+        Routine routine;
+        Node* next = nullptr;
+    };
+
+    std::atomic<Node*> head_{nullptr};
+};
+
+}  // namespace lines
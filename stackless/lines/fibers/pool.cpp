@@ -0,0 +1,167 @@
+#include <lines/fibers/pool.hpp>
+#include <lines/fibers/scheduler.hpp>
+#include <lines/util/random.hpp>
+
+#include <libassert/assert.hpp>
+
+#include <algorithm>
+
+namespace lines {
+
+// Like Go, a worker with local work still checks the shared queue now and then
+constexpr size_t kGlobalQueuePeriod = 61;
+
+SchedulerPool::SchedulerPool(size_t num_workers) {
+    ASSERT(num_workers > 0);
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+void SchedulerPool::Run(Routine root) {
+    ASSERT(IsDone());
+    root_ = std::move(root);
+    live_.store(1);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        threads.emplace_back([this, i] { Scheduler::This().RunWorker(this, i); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void SchedulerPool::Push(size_t worker, Fiber* fiber) {
+    workers_[worker]->deque.Push(fiber);
+    WakeIdle();
+}
+
+void SchedulerPool::PushGlobal(Fiber* fiber) {
+    std::lock_guard guard(global_mutex_);
+    global_.Append(fiber);
+    global_size_.fetch_add(1, std::memory_order::release);
+    WakeIdle();
+}
+
+void SchedulerPool::PushGlobal(FiberQueue& fibers) {
+    size_t count = fibers.Size();
+    {
+        std::lock_guard guard(global_mutex_);
+        global_.Splice(fibers);
+        global_size_.fetch_add(count, std::memory_order::release);
+    }
+    for (size_t i = 0; i < std::min(count, workers_.size()); ++i) {
+        WakeIdle();
+    }
+}
+
+Fiber* SchedulerPool::PopGlobal() {
+    if (global_size_.load(std::memory_order::acquire) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard guard(global_mutex_);
+    auto fiber = global_.PopFront();
+    if (fiber) {
+        global_size_.fetch_sub(1, std::memory_order::relaxed);
+    }
+    return fiber;
+}
+
+Fiber* SchedulerPool::Pick(size_t worker, size_t tick) {
+    if (tick % kGlobalQueuePeriod == 0) {
+        if (auto fiber = PopGlobal()) {
+            return fiber;
+        }
+    }
+    if (auto fiber = workers_[worker]->deque.Pop()) {
+        return fiber;
+    }
+    if (auto fiber = PopGlobal()) {
+        return fiber;
+    }
+    return Steal(worker);
+}
+
+Fiber* SchedulerPool::Steal(size_t thief) {
+    size_t count = workers_.size();
+    size_t start = Random(static_cast<int>(count) - 1);
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim == thief) {
+            continue;
+        }
+        if (auto fiber = workers_[victim]->deque.Steal()) {
+            return fiber;
+        }
+    }
+    return nullptr;
+}
+
+void SchedulerPool::FiberStarted() {
+    live_.fetch_add(1, std::memory_order::relaxed);
+}
+
+void SchedulerPool::FiberFinished() {
+    if (live_.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+        WakeAll();
+    }
+}
+
+bool SchedulerPool::IsDone() const {
+    return live_.load(std::memory_order::acquire) == 0;
+}
+
+// The worker announces itself before the last look for work, and pushers
+// look for sleepers after publishing the fiber, so a wakeup is never lost.
+bool SchedulerPool::StartIdle(size_t worker) {
+    workers_[worker]->sleeping.store(true);
+    sleeping_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+
+    if (HasWork() || IsDone()) {
+        EndIdle(worker);
+        return false;
+    }
+    return true;
+}
+
+void SchedulerPool::EndIdle(size_t worker) {
+    workers_[worker]->sleeping.store(false);
+    sleeping_.fetch_sub(1);
+}
+
+bool SchedulerPool::HasWork() const {
+    if (global_size_.load() > 0) {
+        return true;
+    }
+    for (auto& worker : workers_) {
+        if (worker->deque.Size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SchedulerPool::WakeIdle() {
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+    if (sleeping_.load(std::memory_order::relaxed) == 0) {
+        return;
+    }
+
+    for (auto& worker : workers_) {
+        if (worker->sleeping.exchange(false)) {
+            worker->reactor.Notify();
+            return;
+        }
+    }
+}
+
+void SchedulerPool::WakeAll() {
+    for (auto& worker : workers_) {
+        worker->reactor.Notify();
+    }
+}
+
+}  // namespace lines
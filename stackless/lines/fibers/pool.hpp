@@ -0,0 +1,101 @@
+#pragma once
+
+#include <lines/fibers/fiber.hpp>
+#include <lines/fibers/queue.hpp>
+#include <lines/io/reactor.hpp>
+#include <lines/util/chase_lev_deque.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lines {
+
+// Runs fibers on several threads, each with its own scheduler.
+//
+// A worker runs the fibers it has spawned or woken up from its own deque,
+// and steals from the others when it runs out. Yielding fibers go to a shared
+// queue, so a busy loop of yields cannot starve the fibers of other workers.
+//
+// A worker with nothing to run sleeps until it is woken up by a worker that
+// has spare fibers, or until its next timer is due.
+//
+// Fibers may migrate between workers at any suspension point. WaitQueue and
+// everything built on it (Handle::join, Mutex, Condvar) work across workers.
+// Stackless coroutines, Async* primitives and timers stay on the worker that
+// scheduled them and must not be shared between workers.
+class SchedulerPool {
+public:
+    explicit SchedulerPool(size_t num_workers = std::thread::hardware_concurrency());
+
+    SchedulerPool(const SchedulerPool&) = delete;
+    SchedulerPool& operator=(const SchedulerPool&) = delete;
+
+    // Runs `f` in a fiber and returns once it and every fiber it has spawned
+    // have finished.
+    template <class F>
+    void Run(F&& f) {
+        Run(Routine(std::forward<F>(f)));
+    }
+
+    void Run(Routine root);
+
+    size_t NumWorkers() const {
+        return workers_.size();
+    }
+
+private:
+    friend class Scheduler;
+    friend class Fiber;
+
+    // A fiber that has just become runnable on the worker.
+    void Push(size_t worker, Fiber* fiber);
+    // A fiber that has yielded, any worker may pick it.
+    void PushGlobal(Fiber* fiber);
+    // Fibers spawned together, spread among the workers through the shared queue.
+    void PushGlobal(FiberQueue& fibers);
+
+    Fiber* Pick(size_t worker, size_t tick);
+
+    void FiberStarted();
+    void FiberFinished();
+    bool IsDone() const;
+
+    // Returns false if the worker should look for work again instead of sleeping.
+    bool StartIdle(size_t worker);
+    void EndIdle(size_t worker);
+
+private:
+    Fiber* PopGlobal();
+    Fiber* Steal(size_t thief);
+
+    bool HasWork() const;
+    // Wakes a sleeping worker to take the new fiber, if there is one.
+    void WakeIdle();
+    void WakeAll();
+
+private:
+    struct Worker {
+        ChaseLevDeque<Fiber> deque;
+        // Owned by the pool, so it may be notified after the worker has exited
+        Reactor reactor;
+        std::atomic<bool> sleeping{false};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex global_mutex_;
+    FiberQueue global_;
+    std::atomic<size_t> global_size_{0};
+
+    std::atomic<size_t> sleeping_{0};
+
+    // Fibers that have not finished yet, plus one while the root is starting
+    std::atomic<size_t> live_{0};
+    Routine root_;
+};
+
+}  // namespace lines
@@ -0,0 +1,69 @@
+#include <lines/fibers/run_queue.hpp>
+#include <lines/fibers/fiber.hpp>
+
+#include <libassert/assert.hpp>
+
+#include <utility>
+
+namespace lines {
+
+void RunQueue::SetPolicy(RunPolicy policy) {
+    ASSERT(Empty());
+    policy_ = policy;
+}
+
+void RunQueue::PushWoken(Fiber* fiber) {
+    switch (policy_) {
+        case RunPolicy::Fifo:
+            fibers_.Append(fiber);
+            break;
+        case RunPolicy::Lifo:
+            if (run_next_) {
+                fibers_.Append(run_next_);
+            }
+            run_next_ = fiber;
+            break;
+        case RunPolicy::Random:
+            fibers_.Prepend(fiber);
+            break;
+    }
+}
+
+// Same order as pushing the fibers one by one
+void RunQueue::PushWoken(FiberQueue& fibers) {
+    if (policy_ == RunPolicy::Lifo && !fibers.Empty()) {
+        if (run_next_) {
+            fibers_.Append(run_next_);
+        }
+        run_next_ = fibers.Tail();
+        fibers.Remove(run_next_);
+    }
+    fibers_.Splice(fibers);
+}
+
+void RunQueue::PushYielded(Fiber* fiber) {
+    if (policy_ == RunPolicy::Random) {
+        fibers_.Prepend(fiber);
+    } else {
+        fibers_.Append(fiber);
+    }
+}
+
+Fiber* RunQueue::Pop() {
+    if (run_next_) {
+        return std::exchange(run_next_, nullptr);
+    }
+
+    if (policy_ != RunPolicy::Random) {
+        return fibers_.PopFront();
+    }
+
+    // Only runnable fibers are queued, so the walk needs no filtering
+    auto fiber = fibers_.PickRandom();
+    if (fiber) {
+        fibers_.Remove(fiber);
+    }
+    return fiber;
+}
+
+}  // namespace lines
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <lines/fibers/queue.hpp>
+
+#include <cstddef>
+
+namespace lines {
+
+class Fiber;
+
+enum class RunPolicy {
+    // Fibers run in the order they became runnable.
+    Fifo,
+    // The most recently woken fiber runs next, like Go's runnext slot.
+    // The fiber it displaces and yielding fibers go to the back of the queue.
+    Lifo,
+    // A random fiber runs next, exploring interleavings in tests. O(n) per pick.
+    Random,
+};
+
+// Runnable fibers of a scheduler. Fifo and Lifo pick in O(1).
+class RunQueue {
+public:
+    // Only an empty queue may change its policy.
+    void SetPolicy(RunPolicy policy);
+
+    RunPolicy GetPolicy() const {
+        return policy_;
+    }
+
+    // A fiber that has just become runnable: spawned or woken up.
+    void PushWoken(Fiber* fiber);
+    // Fibers that have just been spawned together, spliced in at once.
+    void PushWoken(FiberQueue& fibers);
+    // A fiber that has given up the processor, but is still runnable.
+    void PushYielded(Fiber* fiber);
+
+    Fiber* Pop();
+
+    bool Empty() const {
+        return !run_next_ && fibers_.Empty();
+    }
+
+    size_t Size() const {
+        return fibers_.Size() + (run_next_ ? 1 : 0);
+    }
+
+private:
+    RunPolicy policy_ = RunPolicy::Random;
+    FiberQueue fibers_;
+    Fiber* run_next_ = nullptr;
+};
+
+}  // namespace lines
@@ -1,5 +1,6 @@
 #include <lines/fibers/scheduler.hpp>
-#include <lines/util/logger.hpp>
+#include <lines/fibers/pool.hpp>
+#include <lines/fibers/shards.hpp>
 #include <lines/util/random.hpp>
 #include <lines/sync/awaitable.hpp>
 #include <lines/time/api.hpp>
@@ -7,37 +8,178 @@
 
 #include <libassert/assert.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <typeinfo>
+#include <utility>
+
 namespace lines {
 
 static thread_local Scheduler scheduler;
 
-void Scheduler::Run() {
-    auto& logger = DefaultLogger();
+constexpr size_t kIoPollPeriod = 61;
+constexpr size_t kMaxDirectSwitches = 16;
 
-    while (Step()) {
+void Scheduler::Run() {
+    while (true) {
+        if (Step()) {
+            continue;
+        }
+        if (!HasWaits()) {
+            break;
+        }
+        Idle();
     }
 
-    ASSERT(fibers_.Empty(), "Deadlock detected");
+    ASSERT(groups_.Empty(), "Deadlock detected");
+    ASSERT(coros_.empty());
     ASSERT(running_ == nullptr);
 }
 
+std::optional<Timepoint> Scheduler::RunOnce() {
+    return RunUntilIdle(1);
+}
+
+std::optional<Timepoint> Scheduler::RunUntilIdle(size_t max_steps) {
+    hosted_ = true;
+    for (size_t step = 0; step < max_steps; ++step) {
+        if (!Step() && !IoPollNow()) {
+            break;
+        }
+    }
+    hosted_ = false;
+    return NextDeadline();
+}
+
+std::optional<Timepoint> Scheduler::RunFor(std::chrono::steady_clock::duration budget) {
+    hosted_ = true;
+    auto end = Now() + budget;
+    while (Now() < end) {
+        if (Step() || IoPollNow()) {
+            continue;
+        }
+        if (!HasWaits()) {
+            break;
+        }
+        Idle(end);
+    }
+    hosted_ = false;
+    return NextDeadline();
+}
+
+void Scheduler::RunWorker(SchedulerPool* pool, size_t index) {
+    pool_ = pool;
+    worker_index_ = index;
+    reactor_ = &pool->workers_[index]->reactor;
+
+    if (index == 0) {
+        Spawn(Fiber::Create(std::move(pool->root_), nullptr));
+        // The root is counted now, drop the startup reference
+        pool->FiberFinished();
+    }
+
+    while (true) {
+        if (Step()) {
+            continue;
+        }
+        if (pool->IsDone() && coros_.empty() && timers_.Empty() && !HasRemoteWork()) {
+            break;
+        }
+        if (pool->StartIdle(worker_index_)) {
+            Idle();
+            pool->EndIdle(worker_index_);
+        }
+    }
+
+    pool_ = nullptr;
+    reactor_ = &own_reactor_;
+}
+
+void Scheduler::RunShard(ShardedScheduler* shards, size_t index) {
+    shards_ = shards;
+    worker_index_ = index;
+    reactor_ = &shards->cores_[index]->reactor;
+
+    if (index == 0) {
+        shards->SubmitTo(0, std::move(shards->root_));
+        // The root is counted now, drop the startup reference
+        shards->TaskFinished();
+    }
+
+    // Fibers never leave the core, so it is done once they all have finished
+    while (true) {
+        if (Step()) {
+            continue;
+        }
+        if (shards->IsDone() && groups_.Empty() && coros_.empty() && timers_.Empty() &&
+            !reactor_->HasWaiters() && !HasRemoteWork()) {
+            break;
+        }
+        if (shards->StartIdle(worker_index_)) {
+            Idle();
+            shards->EndIdle(worker_index_);
+        }
+    }
+
+    shards_ = nullptr;
+    reactor_ = &own_reactor_;
+}
+
+void Scheduler::Spawn(Fiber* fiber) {
+    ++stats_.spawns;
+    Schedule(fiber);
+}
+
+void Scheduler::Spawn(FiberQueue& fibers) {
+    if (fibers.Empty()) {
+        return;
+    }
+
+    stats_.spawns += fibers.Size();
+    if (pool_) {
+        pool_->PushGlobal(fibers);
+    } else {
+        runnable_ += fibers.Size();
+        ActivateGroup(fibers.Head())->fibers_.PushWoken(fibers);
+    }
+}
+
 void Scheduler::Schedule(Fiber* fiber) {
     if (fiber->GetState() == Fiber::State::Dead) {
         ASSERT(fiber == running_);
-        SwitchToSched();
+        SwitchAway();
     } else {
         ASSERT(fiber->GetState() == Fiber::State::Runnable);
-        fibers_.Prepend(fiber);
+        if (pool_) {
+            pool_->Push(worker_index_, fiber);
+        } else {
+            Enqueue(fiber, false);
+        }
     }
 }
 
 void Scheduler::Suspend(IAwaitable* awaitable) {
+    // The fiber is parked by the scheduler after the switch: once parked,
+    // another worker may wake it up and resume it on its own thread.
     running_->SetState(Fiber::State::Suspended);
-    awaitable->Park(running_);
+    park_ = awaitable;
+    ++stats_.suspends;
+    // Hashing a type_index hashes the type's name, ping-pongs suspend
+    // on the same type over and over
+    const auto& type = typeid(*awaitable);
+    if (&type != last_suspend_type_) {
+        last_suspend_type_ = &type;
+        last_suspend_count_ = &suspends_by_type_[type];
+    }
+    ++*last_suspend_count_;
 
-    SwitchToSched();
+    SwitchAway();
 
-    ASSERT(running_->GetState() == Fiber::State::Running);
+    // `this` is the scheduler of the worker the fiber was suspended on
+    This().SettleLeft();
+    ASSERT(Running()->GetState() == Fiber::State::Running);
 }
 
 void Scheduler::Sleep(Timer* timer) {
@@ -45,13 +187,97 @@ void Scheduler::Sleep(Timer* timer) {
     Suspend(timer);
 }
 
+void Scheduler::Schedule(std::coroutine_handle<> handle) {
+    coros_.push_back(handle);
+}
+
+void Scheduler::Sleep(Timer* timer, std::coroutine_handle<> handle) {
+    timer->Park(handle);
+    timers_.Add(timer);
+}
+
+bool Scheduler::CancelTimer(Timer* timer) {
+    if (!timer->IsQueued()) {
+        return false;
+    }
+
+    timers_.Remove(timer);
+    Fire(timer);
+    return true;
+}
+
 void Scheduler::Yield() {
     ASSERT(running_->GetState() == Fiber::State::Running);
+    ++stats_.yields;
+    if (IsAlone()) {
+        return;
+    }
+
     running_->SetState(Fiber::State::Runnable);
-    SwitchToSched();
+    SwitchAway();
+    This().SettleLeft();
+}
+
+void Scheduler::SetRunPolicy(RunPolicy policy) {
+    ASSERT(groups_.Empty());
+    policy_ = policy;
+}
+
+RunPolicy Scheduler::GetRunPolicy() const {
+    return policy_;
+}
+
+SchedulerPool* Scheduler::GetPool() const {
+    return pool_;
+}
+
+void Scheduler::Wake() {
+    reactor_->Notify();
 }
 
-Scheduler& Scheduler::This() {
+void Scheduler::Submit(Routine routine) {
+    // A non-empty inbox has already been kicked
+    if (inbox_.Push(std::move(routine))) {
+        Wake();
+    }
+}
+
+void Scheduler::Hold() {
+    holds_.fetch_add(1, std::memory_order::relaxed);
+}
+
+void Scheduler::Release() {
+    // The last release lets an idle Run() return
+    if (holds_.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+        Wake();
+    }
+}
+
+Reactor& Scheduler::GetReactor() {
+    return *reactor_;
+}
+
+std::chrono::nanoseconds Scheduler::GetIdleTime() const {
+    return stats_.idle_time;
+}
+
+StackPool& Scheduler::GetStackPool() {
+    return stacks_;
+}
+
+SchedulerStats Scheduler::GetStats() const {
+    auto stats = stats_;
+    for (const auto& [type, count] : suspends_by_type_) {
+        stats.suspends_by_type.emplace_back(detail::Demangle(type.name()), count);
+    }
+    std::ranges::sort(stats.suspends_by_type, std::greater{},
+                      [](const auto& entry) { return entry.second; });
+    return stats;
+}
+
+// A fiber may be resumed by another worker, so the address of the
+// thread local must be computed anew on every call, never cached.
+[[gnu::noinline]] Scheduler& Scheduler::This() {
     return scheduler;
 }
 
@@ -61,51 +287,272 @@ Fiber* Scheduler::Running() {
 
 bool Scheduler::Step() {
     bool fibers = FiberStep();
+    bool coros = CoroStep();
+    bool inbox = InboxStep();
+    bool mail = MailStep();
     bool timers = TimerPoll();
+    bool io = IoPoll();
 
-    return fibers || timers;
+    return fibers || coros || inbox || mail || timers || io;
 }
 
 bool Scheduler::FiberStep() {
-    auto fiber = fibers_.PickRandom(/*runnable=*/true);
+    auto fiber = pool_ ? pool_->Pick(worker_index_, tick_++) : PickFiber();
     if (!fiber) {
         return false;
     }
 
-    fibers_.Remove(fiber);
+    // The fiber picked is not counted
+    auto queued = pool_ ? pool_->workers_[worker_index_]->deque.Size() : runnable_;
+    ++stats_.run_queue_lengths[detail::QueueLengthBucket(queued)];
+
+    direct_switches_ = 0;
+    StartSlice(fiber, std::chrono::steady_clock::now());
+    SwitchToFiber(fiber);
 
+    // Back from the last fiber of a run of direct switches
+    Settle(std::exchange(running_, nullptr));
+    return true;
+}
+
+void Scheduler::StartSlice(Fiber* fiber, std::chrono::steady_clock::time_point now) {
     running_ = fiber;
     ASSERT(running_->GetState() == Fiber::State::Runnable);
     running_->SetState(Fiber::State::Running);
-    SwitchToFiber(running_);
-    running_ = nullptr;
+    ++stats_.switches;
+    slice_start_ = now;
+}
+
+std::chrono::steady_clock::time_point Scheduler::EndSlice(Fiber* fiber) {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds slice = now - slice_start_;
 
+    fiber->Account(slice);
+    ++stats_.slices[detail::SliceBucket(slice)];
+    stats_.max_slice = std::max(stats_.max_slice, slice);
+    if (!pool_) {
+        auto group = fiber->GetGroup() ? fiber->GetGroup() : &default_group_;
+        group->Account(slice);
+        if (group->heap_index_ != kNotInHeap) {
+            groups_.Update(group);
+        }
+    }
+    return now;
+}
+
+void Scheduler::Settle(Fiber* fiber) {
     if (fiber->GetState() == Fiber::State::Dead) {
-        delete fiber;
+        ++stats_.deaths;
+        if (IsStackProfilerEnabled()) {
+            // The reserved top is resident from the start
+            auto depth = std::max(fiber->stack_.MeasureDepth(), Fiber::ReservedSize());
+            detail::RecordStackDepth(fiber->site_, depth - Fiber::ReservedSize());
+        }
+        if (fiber->Exit()) {
+            Fiber::Destroy(fiber);
+        }
     } else if (fiber->GetState() == Fiber::State::Runnable) {
-        fibers_.Prepend(fiber);
+        if (pool_) {
+            pool_->PushGlobal(fiber);
+        } else {
+            Enqueue(fiber, true);
+        }
     } else {
         ASSERT(fiber->GetState() == Fiber::State::Suspended);
+        std::exchange(park_, nullptr)->Park(fiber);
+    }
+}
+
+void Scheduler::SettleLeft() {
+    if (auto fiber = std::exchange(left_, nullptr)) {
+        Settle(fiber);
+    }
+}
+
+bool Scheduler::IsAlone() {
+    // A host loop counts steps, a yield must end one
+    if (hosted_ || pool_ || shards_ || !groups_.Empty() || !coros_.empty() || !inbox_.Empty() ||
+        reactor_->HasWaiters()) {
+        return false;
+    }
+    return timers_.Empty() || !timers_.Top()->CompareWithTimepoint(Now());
+}
+
+void Scheduler::Enqueue(Fiber* fiber, bool yielded) {
+    auto group = ActivateGroup(fiber);
+    ++runnable_;
+    if (yielded) {
+        group->fibers_.PushYielded(fiber);
+    } else {
+        group->fibers_.PushWoken(fiber);
+    }
+}
+
+FiberGroup* Scheduler::ActivateGroup(Fiber* fiber) {
+    auto group = fiber->GetGroup() ? fiber->GetGroup() : &default_group_;
+    if (group->heap_index_ == kNotInHeap) {
+        // A group does not bank the time it had nothing to run
+        group->vruntime_ = std::max(group->vruntime_, min_vruntime_);
+        group->fibers_.SetPolicy(policy_);
+        groups_.Add(group);
+    }
+    return group;
+}
+
+Fiber* Scheduler::PickFiber() {
+    if (groups_.Empty()) {
+        return nullptr;
+    }
+
+    auto group = groups_.Top();
+    min_vruntime_ = std::max(min_vruntime_, group->vruntime_);
+    auto fiber = group->fibers_.Pop();
+    --runnable_;
+    if (group->fibers_.Empty()) {
+        groups_.Remove(group);
+    }
+    return fiber;
+}
+
+bool Scheduler::CoroStep() {
+    if (coros_.empty()) {
+        return false;
+    }
+
+    // Coroutines rescheduled during this step wait for the next one.
+    for (size_t count = coros_.size(); count > 0; --count) {
+        auto handle = coros_.front();
+        coros_.pop_front();
+        handle.resume();
     }
 
     return true;
 }
 
+bool Scheduler::InboxStep() {
+    return inbox_.Drain();
+}
+
+bool Scheduler::MailStep() {
+    return shards_ && shards_->Drain(worker_index_);
+}
+
+bool Scheduler::HasRemoteWork() const {
+    return !inbox_.Empty() || holds_.load(std::memory_order::acquire) > 0;
+}
+
 bool Scheduler::TimerPoll() {
     if (timers_.Empty()) {
         return false;
     }
 
+    bool fired = false;
     Timepoint tp = Now();
     while (!timers_.Empty() && timers_.Top()->CompareWithTimepoint(tp)) {
-        auto fiber = timers_.Top()->Unpark();
+        auto timer = timers_.Top();
         timers_.Pop();
-        ASSERT(fiber->GetState() == Fiber::State::Suspended);
-        fiber->SetState(Fiber::State::Runnable);
-        Schedule(fiber);
+        ++stats_.timer_fires;
+        Fire(timer);
+        fired = true;
     }
 
-    return true;
+    return fired;
+}
+
+// A busy scheduler polls its fds every few steps, an idle one blocks on them
+bool Scheduler::IoPoll() {
+    if (!reactor_->HasWaiters() || ++io_tick_ % kIoPollPeriod != 0) {
+        return false;
+    }
+    return reactor_->Poll(Timepoint{});
+}
+
+bool Scheduler::IoPollNow() {
+    return reactor_->HasWaiters() && reactor_->Poll(Timepoint{});
+}
+
+void Scheduler::Fire(Timer* timer) {
+    if (auto handle = timer->UnparkCoroutine()) {
+        Schedule(handle);
+        return;
+    }
+
+    auto fiber = timer->Unpark();
+    ASSERT(fiber->GetState() == Fiber::State::Suspended);
+    fiber->SetState(Fiber::State::Runnable);
+    Schedule(fiber);
+}
+
+bool Scheduler::HasWaits() const {
+    return !timers_.Empty() || reactor_->HasWaiters() || HasRemoteWork();
+}
+
+std::optional<Timepoint> Scheduler::NextDeadline() const {
+    if (!groups_.Empty() || !coros_.empty() || !inbox_.Empty()) {
+        return Timepoint{};
+    }
+    if (!timers_.Empty()) {
+        return timers_.Top()->GetTimepoint();
+    }
+    return std::nullopt;
+}
+
+void Scheduler::Idle(std::optional<Timepoint> limit) {
+    std::optional<Timepoint> deadline = limit;
+    if (!timers_.Empty()) {
+        auto due = timers_.Top()->GetTimepoint();
+        deadline = deadline ? std::min(*deadline, due) : due;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    reactor_->Poll(deadline);
+    stats_.idle_time += std::chrono::steady_clock::now() - start;
+}
+
+// Pool workers always go through the scheduler: a fiber may only be
+// resumed by another worker once it has been settled off its stack.
+void Scheduler::SwitchAway() {
+    auto fiber = running_;
+    auto now = EndSlice(fiber);
+    if (pool_ || direct_switches_ >= kMaxDirectSwitches) {
+        SwitchToSched();
+        return;
+    }
+
+    // A yielding fiber is queued before the pick, as it would be through the
+    // scheduler: picking first would move min_vruntime_ past its group and
+    // clamp away the credit the group has banked
+    bool yielded = fiber->GetState() == Fiber::State::Runnable;
+    if (yielded) {
+        Enqueue(fiber, true);
+    }
+
+    auto next = PickFiber();
+    if (next == fiber && runnable_ > 0) {
+        // Picked again over other fibers: goes on without a switch, but
+        // counts against the budget so that the scheduler still gets a turn
+        ++direct_switches_;
+        fiber->SetState(Fiber::State::Running);
+        slice_start_ = now;
+        return;
+    }
+    if (!next || next == fiber) {
+        // Alone in the run queue: the yield is for the scheduler's other work
+        SwitchToSched();
+        return;
+    }
+
+    ++stats_.run_queue_lengths[detail::QueueLengthBucket(runnable_)];
+    // A single clock read ends a slice and starts the next
+    StartSlice(next, now);
+    ++direct_switches_;
+    ++stats_.direct_switches;
+    left_ = yielded ? nullptr : fiber;
+    if (fiber->GetState() == Fiber::State::Dead) {
+        fiber->GetContext().SwitchLast(next->GetContext());
+    } else {
+        fiber->GetContext().Switch(next->GetContext());
+    }
 }
 
 void Scheduler::SwitchToFiber(Fiber* fiber) {
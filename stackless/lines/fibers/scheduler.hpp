@@ -1,39 +1,199 @@
 #pragma once
 
+#include <lines/ctx/stack_pool.hpp>
 #include <lines/fibers/fiber.hpp>
-#include <lines/fibers/queue.hpp>
+#include <lines/fibers/group.hpp>
+#include <lines/fibers/inbox.hpp>
+#include <lines/fibers/run_queue.hpp>
+#include <lines/fibers/stats.hpp>
+#include <lines/io/reactor.hpp>
 #include <lines/time/queue.hpp>
 #include <lines/time/timer.hpp>
 #include <lines/sync/awaitable.hpp>
+#include <lines/util/indexed_heap.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
 
 namespace lines {
 
+class SchedulerPool;
+class ShardedScheduler;
+
 class Scheduler {
 public:
+    // Runs until no fiber can ever become runnable again.
     void Run();
 
+    // Embedding in a host loop. These run what is ready and return when the
+    // scheduler needs to run next: a passed timepoint if it has work ready,
+    // the earliest timer deadline, or nullopt if it only waits for wakeups
+    // (fds, Submit(), fibers parked on each other). The host may poll the
+    // reactor's fd to learn about those. Parked fibers are not a deadlock.
+    std::optional<Timepoint> RunOnce();
+    // Runs at most `max_steps` steps, never blocks.
+    std::optional<Timepoint> RunUntilIdle(size_t max_steps = SIZE_MAX);
+    // Runs for `budget`, waiting for timers and fds while nothing is ready.
+    // Returns early once nothing can wake up.
+    std::optional<Timepoint> RunFor(std::chrono::steady_clock::duration budget);
+
+    // Schedules a fiber that has just been created.
+    void Spawn(Fiber* fiber);
+    // Fibers of the same group, spliced into the run queue at once.
+    void Spawn(FiberQueue& fibers);
     void Schedule(Fiber* fiber);
     void Suspend(IAwaitable* awaitable);
     void Sleep(Timer* awaitable);
     void Yield();
 
+    // Stackless coroutines share the scheduler with fibers,
+    // but are resumed on the scheduler's own stack.
+    void Schedule(std::coroutine_handle<> handle);
+    void Sleep(Timer* timer, std::coroutine_handle<> handle);
+
+    // Wakes the sleeper of a queued timer before its deadline.
+    // Returns false if the timer has already fired.
+    bool CancelTimer(Timer* timer);
+
+    // Defaults to RunPolicy::Random, may be changed while no fiber is runnable.
+    void SetRunPolicy(RunPolicy policy);
+    RunPolicy GetRunPolicy() const;
+
+    // The pool this scheduler is a worker of, if any.
+    SchedulerPool* GetPool() const;
+
+    // Interrupts the idle wait of the scheduler, safe to call from any thread.
+    // It only writes to an eventfd, so it is async-signal-safe as well.
+    void Wake();
+
+    // Runs `routine` on the thread of the scheduler, outside of any fiber:
+    // it may wake fibers up or schedule coroutines, but must not block.
+    // Safe to call from any thread, but not from a signal handler: the entry
+    // and possibly the routine are allocated. A handler should set an atomic
+    // flag and call Wake() instead.
+    void Submit(Routine routine);
+
+    // While the scheduler is held, Run() waits for submissions instead of
+    // returning, so its fibers may wait for wakeups from other threads.
+    // Release() may be called from any thread.
+    void Hold();
+    void Release();
+
+    // Fds the fibers of this scheduler wait for.
+    Reactor& GetReactor();
+
+    // Time the thread has spent blocked with nothing to run.
+    std::chrono::nanoseconds GetIdleTime() const;
+
+    // Stacks of finished fibers, reused by the fibers spawned on this thread.
+    StackPool& GetStackPool();
+
+    // A snapshot of the counters, cheap enough to be always on.
+    SchedulerStats GetStats() const;
+
     static Scheduler& This();
     static Fiber* Running();
 
 private:
+    friend class Fiber;
+    friend class SchedulerPool;
+    friend class ShardedScheduler;
+
+    void RunWorker(SchedulerPool* pool, size_t index);
+    void RunShard(ShardedScheduler* shards, size_t index);
+
     bool Step();
     bool FiberStep();
+    // Runnable fibers of a single scheduler are kept in their groups
+    void Enqueue(Fiber* fiber, bool yielded);
+    // Queues the group of the fiber if it has nothing to run yet.
+    FiberGroup* ActivateGroup(Fiber* fiber);
+    Fiber* PickFiber();
+    bool CoroStep();
+    bool InboxStep();
+    bool MailStep();
+    bool HasRemoteWork() const;
     bool TimerPoll();
+    bool IoPoll();
+    // Polls the fds without waiting, unlike IoPoll() on every call.
+    bool IoPollNow();
+    void Fire(Timer* timer);
+    // Something may still wake a fiber up: a timer, an fd or another thread.
+    bool HasWaits() const;
+    std::optional<Timepoint> NextDeadline() const;
+    // Blocks until the earliest timer is due, an fd is ready or Wake() is called,
+    // but no longer than `limit`.
+    void Idle(std::optional<Timepoint> limit = std::nullopt);
+
+    void StartSlice(Fiber* fiber, std::chrono::steady_clock::time_point now);
+    // Accounts the slice of the fiber, returns the time it ended.
+    std::chrono::steady_clock::time_point EndSlice(Fiber* fiber);
+    // Puts a fiber that has left its stack where it belongs: back in the run
+    // queue, parked on its awaitable, or gone if it is dead.
+    void Settle(Fiber* fiber);
+    // Called by a fiber as soon as it is switched to.
+    void SettleLeft();
+    // Only the running fiber wants the thread: a yield may return at once.
+    bool IsAlone();
 
+    // Leaves the running fiber for the next runnable one, straight from
+    // context to context when possible, through the scheduler otherwise.
+    void SwitchAway();
     void SwitchToFiber(Fiber* fiber);
     void SwitchToSched();
 
 private:
-    FiberQueue fibers_;
+    // Groups with runnable fibers, by virtual runtime
+    IndexedHeap<FiberGroup> groups_;
+    FiberGroup default_group_;
+    uint64_t min_vruntime_ = 0;
+    RunPolicy policy_ = RunPolicy::Random;
+    std::deque<std::coroutine_handle<>> coros_;
     TimerQueue timers_;
 
+    Reactor own_reactor_;
+    // Pool workers use the reactor of the pool's worker
+    Reactor* reactor_ = &own_reactor_;
+    size_t io_tick_ = 0;
+
+    StackPool stacks_;
+
+    Inbox inbox_;
+    std::atomic<size_t> holds_{0};
+
+    SchedulerStats stats_;
+    std::unordered_map<std::type_index, uint64_t> suspends_by_type_;
+    const std::type_info* last_suspend_type_ = nullptr;
+    uint64_t* last_suspend_count_ = nullptr;
+    // Fibers queued in groups_
+    size_t runnable_ = 0;
+
     Context sched_ctx_;
     Fiber* running_ = nullptr;
+    std::chrono::steady_clock::time_point slice_start_;
+    // Parked once the running fiber has left its stack
+    IAwaitable* park_ = nullptr;
+    // Switched away from directly, settled by the fiber switched to
+    Fiber* left_ = nullptr;
+    // Since the scheduler last ran, bounded so that it still gets to
+    // run coroutines, timers and io under a ping-pong of fibers
+    size_t direct_switches_ = 0;
+    // Run by RunOnce(), RunUntilIdle() or RunFor()
+    bool hosted_ = false;
+
+    SchedulerPool* pool_ = nullptr;
+    ShardedScheduler* shards_ = nullptr;
+    // Index of the thread in its pool or sharded group
+    size_t worker_index_ = 0;
+    size_t tick_ = 0;
 };
 
 }  // namespace lines
@@ -0,0 +1,122 @@
+#include <lines/fibers/shards.hpp>
+#include <lines/fibers/scheduler.hpp>
+#include <lines/util/defer.hpp>
+
+#include <libassert/assert.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace lines {
+
+ShardedScheduler::ShardedScheduler(size_t num_cores, bool pin) : pin_(pin) {
+    ASSERT(num_cores > 0);
+    for (size_t i = 0; i < num_cores; ++i) {
+        cores_.push_back(std::make_unique<Core>(num_cores));
+    }
+}
+
+void ShardedScheduler::Run(Routine root) {
+    ASSERT(IsDone());
+    root_ = std::move(root);
+    live_.store(1);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < cores_.size(); ++i) {
+        threads.emplace_back([this, i] { RunCore(i); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ShardedScheduler::RunCore(size_t index) {
+    if (pin_) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % std::thread::hardware_concurrency(), &cpus);
+        // Best effort: the cpu may be outside of the process's affinity mask
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    Scheduler::This().RunShard(this, index);
+}
+
+size_t ShardedScheduler::ThisCore() {
+    auto& scheduler = Scheduler::This();
+    ASSERT(scheduler.shards_, "Not a core of a ShardedScheduler");
+    return scheduler.worker_index_;
+}
+
+void ShardedScheduler::SubmitTo(size_t core, Routine f) {
+    TaskStarted();
+    Post(core, [this, f = std::move(f)]() mutable {
+        auto fiber = Fiber::Create(
+            [this, f = std::move(f)]() mutable {
+                Defer finished([this] { TaskFinished(); });
+                f();
+            },
+            nullptr);
+        Scheduler::This().Spawn(fiber);
+    });
+}
+
+// The core announces itself before the last look at its mailboxes, and
+// posters look for a sleeper after the push, so a wakeup is never lost.
+void ShardedScheduler::Post(size_t core, Routine routine) {
+    auto& target = *cores_[core];
+    target.inbound[ThisCore()].Push(std::move(routine));
+
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+    if (target.sleeping.load(std::memory_order::relaxed) && target.sleeping.exchange(false)) {
+        target.reactor.Notify();
+    }
+}
+
+bool ShardedScheduler::Drain(size_t core) {
+    bool drained = false;
+    for (auto& mailbox : cores_[core]->inbound) {
+        while (auto routine = mailbox.Pop()) {
+            (*routine)();
+            drained = true;
+        }
+    }
+    return drained;
+}
+
+void ShardedScheduler::TaskStarted() {
+    live_.fetch_add(1, std::memory_order::relaxed);
+}
+
+void ShardedScheduler::TaskFinished() {
+    if (live_.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+        for (auto& core : cores_) {
+            core->reactor.Notify();
+        }
+    }
+}
+
+bool ShardedScheduler::IsDone() const {
+    return live_.load(std::memory_order::acquire) == 0;
+}
+
+bool ShardedScheduler::StartIdle(size_t core) {
+    auto& self = *cores_[core];
+    self.sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+
+    bool mail = false;
+    for (auto& mailbox : self.inbound) {
+        mail = mail || !mailbox.Empty();
+    }
+    if (mail || IsDone()) {
+        EndIdle(core);
+        return false;
+    }
+    return true;
+}
+
+void ShardedScheduler::EndIdle(size_t core) {
+    cores_[core]->sleeping.store(false);
+}
+
+}  // namespace lines
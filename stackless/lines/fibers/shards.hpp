@@ -0,0 +1,136 @@
+#pragma once
+
+#include <lines/fibers/fiber.hpp>
+#include <lines/io/reactor.hpp>
+#include <lines/sync/wait_queue.hpp>
+#include <lines/util/spsc_queue.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <utility>
+#include <vector>
+
+namespace lines {
+
+// Runs one scheduler per core, shared-nothing: fibers never migrate, and
+// cores talk only through mailboxes, one single-producer queue for every
+// pair of cores. A fiber stays with its caches and its NUMA node.
+//
+// Everything a fiber touches belongs to its core, unless it is passed along
+// with a message. Mailboxes are used from the fibers of the group only.
+class ShardedScheduler {
+public:
+    // Core `i` runs on the cpu `i % hardware_concurrency()` if `pin` is set.
+    explicit ShardedScheduler(size_t num_cores = std::thread::hardware_concurrency(),
+                              bool pin = true);
+
+    ShardedScheduler(const ShardedScheduler&) = delete;
+    ShardedScheduler& operator=(const ShardedScheduler&) = delete;
+
+    // Runs `f` in a fiber on core 0 and returns once it and every fiber
+    // submitted to a core have finished.
+    template <class F>
+    void Run(F&& f) {
+        Run(Routine(std::forward<F>(f)));
+    }
+
+    void Run(Routine root);
+
+    size_t NumCores() const {
+        return cores_.size();
+    }
+
+    // The core of the running fiber.
+    static size_t ThisCore();
+
+    // Runs `f` in a new fiber on `core`.
+    void SubmitTo(size_t core, Routine f);
+
+    // Runs `f` in a new fiber on `core` and suspends the calling fiber until
+    // its result comes back. Exceptions are rethrown to the caller.
+    template <class F>
+    auto CallOn(size_t core, F f) -> std::invoke_result_t<F&> {
+        using T = std::invoke_result_t<F&>;
+
+        std::optional<std::conditional_t<std::is_void_v<T>, std::monostate, T>> result;
+        std::exception_ptr error;
+        bool done = false;
+        WaitQueue replied;
+
+        auto epoch = replied.Epoch();
+        SubmitTo(core, [&, this, home = ThisCore()] {
+            auto reply = [&] {
+                done = true;
+                replied.WakeAll();
+            };
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    f();
+                    result.emplace();
+                } else {
+                    result.emplace(f());
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // The caller's state is only touched on its core
+            Post(home, std::move(reply));
+        });
+
+        while (!done) {
+            replied.Wait(epoch);
+            epoch = replied.Epoch();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*result);
+        }
+    }
+
+private:
+    friend class Scheduler;
+
+    // Runs `routine` on the scheduler of `core`, outside of any fiber.
+    void Post(size_t core, Routine routine);
+    // Runs the routines posted to the core, returns false if there were none.
+    bool Drain(size_t core);
+
+    void TaskStarted();
+    void TaskFinished();
+    bool IsDone() const;
+
+    // Returns false if the core should look for work again instead of sleeping.
+    bool StartIdle(size_t core);
+    void EndIdle(size_t core);
+
+    void RunCore(size_t index);
+
+private:
+    struct Core {
+        explicit Core(size_t num_cores) : inbound(num_cores) {
+        }
+
+        // A mailbox from every core
+        std::vector<SpscQueue<Routine>> inbound;
+        // Owned by the group, so it may be notified after the core has exited
+        Reactor reactor;
+        std::atomic<bool> sleeping{false};
+    };
+
+    std::vector<std::unique_ptr<Core>> cores_;
+    bool pin_;
+
+    // The root and the submitted fibers that have not finished yet
+    std::atomic<size_t> live_{0};
+    Routine root_;
+};
+
+}  // namespace lines
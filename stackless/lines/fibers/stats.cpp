@@ -0,0 +1,166 @@
+#include <lines/fibers/stats.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <tuple>
+
+#include <cxxabi.h>
+
+namespace lines {
+
+namespace detail {
+
+size_t QueueLengthBucket(size_t length) {
+    return std::min<size_t>(std::bit_width(length), kQueueLengthBuckets - 1);
+}
+
+size_t SliceBucket(std::chrono::nanoseconds slice) {
+    size_t bucket = 0;
+    for (int64_t bound = 1000; bucket + 1 < kSliceBuckets && slice.count() >= bound; bound *= 10) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+size_t StackDepthBucket(size_t depth) {
+    if (depth <= 4096) {
+        return 0;
+    }
+    return std::min<size_t>(std::bit_width((depth - 1) >> 12), kStackDepthBuckets - 1);
+}
+
+std::string Demangle(const char* name) {
+    int status = 0;
+    std::unique_ptr<char, decltype(&std::free)> demangled(
+        abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free);
+    return status == 0 ? demangled.get() : name;
+}
+
+}  // namespace detail
+
+namespace {
+
+std::atomic<bool> stack_profiler{false};
+
+// Fibers may die on any thread, so the registry is never destroyed.
+class StackProfile {
+public:
+    static StackProfile& Instance() {
+        static StackProfile* profile = new StackProfile;
+        return *profile;
+    }
+
+    void Record(const std::source_location& site, size_t depth) {
+        std::lock_guard guard(mutex_);
+        auto [it, inserted] = sites_.try_emplace(Key{site.file_name(), site.line(), site.column()});
+        auto& entry = it->second;
+        if (inserted) {
+            entry.site = std::string(site.file_name()) + ':' + std::to_string(site.line()) + ' ' +
+                         site.function_name();
+        }
+        ++entry.fibers;
+        entry.max_depth = std::max(entry.max_depth, depth);
+        ++entry.depths[detail::StackDepthBucket(depth)];
+    }
+
+    std::vector<StackProfileEntry> Snapshot() {
+        std::vector<StackProfileEntry> entries;
+        {
+            std::lock_guard guard(mutex_);
+            for (const auto& [site, entry] : sites_) {
+                entries.push_back(entry);
+            }
+        }
+        std::ranges::sort(entries, std::greater{}, &StackProfileEntry::max_depth);
+        return entries;
+    }
+
+    void Reset() {
+        std::lock_guard guard(mutex_);
+        sites_.clear();
+    }
+
+private:
+    // The file names are literals, compared by contents: the same file may be
+    // named by a different copy in every translation unit
+    using Key = std::tuple<std::string_view, uint_least32_t, uint_least32_t>;
+
+    std::mutex mutex_;
+    std::map<Key, StackProfileEntry> sites_;
+};
+
+template <size_t N>
+void PrintBuckets(std::ostream& out, const std::array<uint64_t, N>& buckets) {
+    out << '[';
+    for (size_t bucket = 0; bucket < N; ++bucket) {
+        out << (bucket ? " " : "") << buckets[bucket];
+    }
+    out << ']';
+}
+
+}  // namespace
+
+namespace detail {
+
+void RecordStackDepth(const std::source_location& site, size_t depth) {
+    StackProfile::Instance().Record(site, depth);
+}
+
+}  // namespace detail
+
+void EnableStackProfiler(bool enable) {
+    stack_profiler.store(enable, std::memory_order::relaxed);
+}
+
+bool IsStackProfilerEnabled() {
+    return stack_profiler.load(std::memory_order::relaxed);
+}
+
+std::vector<StackProfileEntry> GetStackProfile() {
+    return StackProfile::Instance().Snapshot();
+}
+
+void ResetStackProfile() {
+    StackProfile::Instance().Reset();
+}
+
+void DumpStackProfile(std::ostream& out) {
+    out << "stack depths (<=4KiB <=8KiB ... <=64MiB >64MiB)\n";
+    for (const auto& entry : GetStackProfile()) {
+        out << std::setw(10) << entry.max_depth / 1024 << "KiB max, " << entry.fibers
+            << " fibers ";
+        PrintBuckets(out, entry.depths);
+        out << " " << entry.site << '\n';
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, const SchedulerStats& stats) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    out << "switches " << stats.switches << " (" << stats.direct_switches << " direct), spawns "
+        << stats.spawns << ", deaths " << stats.deaths << ", yields " << stats.yields
+        << ", suspends " << stats.suspends << ", timer fires " << stats.timer_fires << '\n';
+    out << "idle " << duration_cast<microseconds>(stats.idle_time).count() << "us, max slice "
+        << duration_cast<microseconds>(stats.max_slice).count() << "us\n";
+    out << "run queue (0 1 2-3 4-7 ... >=1024) ";
+    PrintBuckets(out, stats.run_queue_lengths);
+    out << "\nslices (<1us <10us <100us <1ms <10ms <100ms <1s >=1s) ";
+    PrintBuckets(out, stats.slices);
+    out << '\n';
+    for (const auto& [type, count] : stats.suspends_by_type) {
+        out << std::setw(12) << count << " suspends on " << type << '\n';
+    }
+    return out;
+}
+
+}  // namespace lines
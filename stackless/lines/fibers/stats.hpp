@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <source_location>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lines {
+
+// Run queue lengths are bucketed by powers of two: 0, 1, 2-3, 4-7, ..., >=1024.
+inline constexpr size_t kQueueLengthBuckets = 12;
+// Slices are bucketed by decades: <1us, <10us, ..., <1s, >=1s.
+inline constexpr size_t kSliceBuckets = 8;
+
+// Counters of a single scheduler since its thread started,
+// see Scheduler::GetStats().
+struct SchedulerStats {
+    // Switches to a fiber
+    uint64_t switches = 0;
+    // Of which straight from another fiber, not through the scheduler
+    uint64_t direct_switches = 0;
+    uint64_t spawns = 0;
+    uint64_t deaths = 0;
+    uint64_t yields = 0;
+    uint64_t suspends = 0;
+    uint64_t timer_fires = 0;
+
+    // Demangled type of the awaitable and the number of suspends on it
+    std::vector<std::pair<std::string, uint64_t>> suspends_by_type;
+    // Runnable fibers seen by every pick
+    std::array<uint64_t, kQueueLengthBuckets> run_queue_lengths{};
+    // Time fibers ran before switching away
+    std::array<uint64_t, kSliceBuckets> slices{};
+    std::chrono::nanoseconds max_slice{};
+    std::chrono::nanoseconds idle_time{};
+};
+
+std::ostream& operator<<(std::ostream& out, const SchedulerStats& stats);
+
+// Stack depths are bucketed by powers of two: <=4KiB, <=8KiB, ..., <=64MiB, more.
+inline constexpr size_t kStackDepthBuckets = 16;
+
+// How deep the fibers spawned at a site have touched their stacks, not
+// counting the control block and the fiber local storage. Recorded at the
+// death of every fiber while the stack profiler is enabled, at page
+// granularity. A site is the source location of the Spawn() or SpawnMany()
+// call, named `file:line function`.
+struct StackProfileEntry {
+    std::string site;
+    uint64_t fibers = 0;
+    size_t max_depth = 0;
+    std::array<uint64_t, kStackDepthBuckets> depths{};
+};
+
+// Off by default: while it is on, the stacks of dead fibers are measured
+// with mincore. A new fiber releases the memory of its stack below the
+// control block first, so a fiber on a pooled stack is measured from scratch.
+void EnableStackProfiler(bool enable = true);
+bool IsStackProfilerEnabled();
+
+// Snapshot of all the threads, sorted by max depth.
+std::vector<StackProfileEntry> GetStackProfile();
+void ResetStackProfile();
+
+void DumpStackProfile(std::ostream& out);
+
+namespace detail {
+
+size_t QueueLengthBucket(size_t length);
+size_t SliceBucket(std::chrono::nanoseconds slice);
+size_t StackDepthBucket(size_t depth);
+
+void RecordStackDepth(const std::source_location& site, size_t depth);
+
+std::string Demangle(const char* name);
+
+}  // namespace detail
+
+}  // namespace lines
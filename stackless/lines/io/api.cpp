@@ -0,0 +1,131 @@
+#include <lines/io/api.hpp>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef LINES_THREADS
+
+#include <poll.h>
+
+namespace lines::io {
+
+namespace {
+
+void Wait(int fd, short events) {
+    pollfd request{.fd = fd, .events = events, .revents = 0};
+    while (poll(&request, 1, -1) < 0 && errno == EINTR) {
+    }
+}
+
+}  // namespace
+
+void WaitReadable(int fd) {
+    Wait(fd, POLLIN);
+}
+
+void WaitWritable(int fd) {
+    Wait(fd, POLLOUT);
+}
+
+}  // namespace lines::io
+
+#else
+
+#include <lines/fibers/scheduler.hpp>
+#include <lines/io/reactor.hpp>
+
+#include <sys/epoll.h>
+
+namespace lines::io {
+
+void WaitReadable(int fd) {
+    FdAwaitable awaitable(fd, EPOLLIN);
+    Scheduler::This().Suspend(&awaitable);
+}
+
+void WaitWritable(int fd) {
+    FdAwaitable awaitable(fd, EPOLLOUT);
+    Scheduler::This().Suspend(&awaitable);
+}
+
+}  // namespace lines::io
+
+#endif
+
+namespace lines::io {
+
+namespace {
+
+bool WouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+}  // namespace
+
+int SetNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+ssize_t Read(int fd, void* buffer, size_t size) {
+    while (true) {
+        auto result = read(fd, buffer, size);
+        if (result >= 0 || (errno != EINTR && !WouldBlock())) {
+            return result;
+        }
+        if (WouldBlock()) {
+            WaitReadable(fd);
+        }
+    }
+}
+
+ssize_t Write(int fd, const void* buffer, size_t size) {
+    while (true) {
+        auto result = write(fd, buffer, size);
+        if (result >= 0 || (errno != EINTR && !WouldBlock())) {
+            return result;
+        }
+        if (WouldBlock()) {
+            WaitWritable(fd);
+        }
+    }
+}
+
+int Accept(int fd, sockaddr* address, socklen_t* length) {
+    while (true) {
+        int result = accept4(fd, address, length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (result >= 0 || (errno != EINTR && !WouldBlock())) {
+            return result;
+        }
+        if (WouldBlock()) {
+            WaitReadable(fd);
+        }
+    }
+}
+
+int Connect(int fd, const sockaddr* address, socklen_t length) {
+    int result = connect(fd, address, length);
+    if (result == 0 || (errno != EINPROGRESS && errno != EINTR)) {
+        return result;
+    }
+
+    // The connection completes in the background, its outcome is in SO_ERROR
+    WaitWritable(fd);
+    int error = 0;
+    socklen_t size = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0) {
+        return -1;
+    }
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+}  // namespace lines::io
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+namespace lines::io {
+
+// Fiber-blocking counterparts of the syscalls: when the fd is not ready,
+// the running fiber is parked until it is, while the scheduler runs others.
+// The fds must be non-blocking. Errors are reported as by the syscalls,
+// with -1 and errno.
+
+// Sets O_NONBLOCK, returns -1 on failure.
+int SetNonBlocking(int fd);
+
+ssize_t Read(int fd, void* buffer, size_t size);
+ssize_t Write(int fd, const void* buffer, size_t size);
+
+// The accepted socket is non-blocking.
+int Accept(int fd, sockaddr* address = nullptr, socklen_t* length = nullptr);
+int Connect(int fd, const sockaddr* address, socklen_t length);
+
+void WaitReadable(int fd);
+void WaitWritable(int fd);
+
+}  // namespace lines::io
@@ -0,0 +1,136 @@
+#include <lines/io/reactor.hpp>
+#include <lines/fibers/scheduler.hpp>
+
+#include <libassert/assert.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace lines {
+
+namespace {
+
+constexpr int kMaxEvents = 64;
+
+void Wake(Fiber* fiber) {
+    ASSERT(fiber->GetState() == Fiber::State::Suspended);
+    fiber->SetState(Fiber::State::Runnable);
+    Scheduler::This().Schedule(fiber);
+}
+
+int Timeout(std::optional<Timepoint> deadline) {
+    if (!deadline) {
+        return -1;
+    }
+    // Rounded up, so the deadline has passed when the wait times out
+    auto left = std::chrono::ceil<Duration>(*deadline - Now()).count();
+    return static_cast<int>(std::clamp<Duration::rep>(left, 0, INT_MAX));
+}
+
+}  // namespace
+
+void FdAwaitable::Park(Fiber* fiber) {
+    fiber_ = fiber;
+    Scheduler::This().GetReactor().Arm(this);
+}
+
+Reactor::Reactor() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT(epoll_fd_ >= 0);
+    event_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ASSERT(event_fd_ >= 0);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = event_fd_;
+    int ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event);
+    ASSERT(ret == 0);
+}
+
+Reactor::~Reactor() {
+    ASSERT(fds_.empty());
+    close(event_fd_);
+    close(epoll_fd_);
+}
+
+void Reactor::Arm(FdAwaitable* awaitable) {
+    auto [it, added] = fds_.try_emplace(awaitable->fd_);
+    auto& interest = it->second;
+
+    auto& slot = (awaitable->events_ & EPOLLIN) ? interest.reader : interest.writer;
+    ASSERT(slot == nullptr, "Fd is already awaited", awaitable->fd_);
+    slot = awaitable;
+
+    Update(awaitable->fd_, interest, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+}
+
+// Registrations are one-shot: an fd reports once per Arm(),
+// and is removed from epoll once it has no waiters.
+void Reactor::Update(int fd, const Interest& interest, int op) {
+    epoll_event event{};
+    event.events = EPOLLONESHOT;
+    if (interest.reader) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (interest.writer) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+
+    int ret = epoll_ctl(epoll_fd_, op, fd, &event);
+    ASSERT(ret == 0, "epoll_ctl failed", fd, errno);
+}
+
+bool Reactor::Poll(std::optional<Timepoint> deadline) {
+    epoll_event events[kMaxEvents];
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents, Timeout(deadline));
+    ASSERT(count >= 0 || errno == EINTR);
+
+    bool woken = false;
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == event_fd_) {
+            uint64_t value;
+            [[maybe_unused]] auto bytes = read(event_fd_, &value, sizeof(value));
+            continue;
+        }
+
+        auto it = fds_.find(fd);
+        ASSERT(it != fds_.end());
+        auto& interest = it->second;
+
+        // Errors and hangups wake both sides, the syscall reports them
+        uint32_t ready = events[i].events;
+        bool failed = ready & (EPOLLERR | EPOLLHUP);
+        if (interest.reader && (failed || (ready & (EPOLLIN | EPOLLRDHUP)))) {
+            Wake(std::exchange(interest.reader, nullptr)->fiber_);
+            woken = true;
+        }
+        if (interest.writer && (failed || (ready & EPOLLOUT))) {
+            Wake(std::exchange(interest.writer, nullptr)->fiber_);
+            woken = true;
+        }
+
+        if (interest.reader || interest.writer) {
+            Update(fd, interest, EPOLL_CTL_MOD);
+        } else {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            fds_.erase(it);
+        }
+    }
+
+    return woken;
+}
+
+void Reactor::Notify() {
+    uint64_t value = 1;
+    [[maybe_unused]] auto bytes = write(event_fd_, &value, sizeof(value));
+}
+
+}  // namespace lines
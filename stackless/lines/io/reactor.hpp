@@ -0,0 +1,79 @@
+#pragma once
+
+#include <lines/sync/awaitable.hpp>
+#include <lines/time/api.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace lines {
+
+class Fiber;
+
+// Parks the running fiber until the fd is readable (EPOLLIN)
+// or writable (EPOLLOUT). The fd must be pollable by epoll.
+class FdAwaitable : public IAwaitable {
+public:
+    FdAwaitable(int fd, uint32_t events) : fd_(fd), events_(events) {
+    }
+
+    void Park(Fiber* fiber) override;
+
+private:
+    friend class Reactor;
+
+    int fd_;
+    uint32_t events_;
+    Fiber* fiber_ = nullptr;
+};
+
+// Readiness of the fds the fibers of a scheduler wait for, and the idle wait
+// of the scheduler itself: epoll, plus an eventfd for wakeups from other threads.
+//
+// Only the owning thread arms and polls, Notify() is thread-safe.
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // At most one reader and one writer may wait for an fd at a time.
+    void Arm(FdAwaitable* awaitable);
+
+    // Wakes the fibers whose fds are ready. If there are none, blocks until
+    // the deadline, or without one until an fd is ready or Notify() is called.
+    // A passed deadline only polls. Returns true if some fiber was woken.
+    bool Poll(std::optional<Timepoint> deadline);
+
+    // A notification sent while nobody polls is not lost:
+    // the next Poll() returns right away.
+    void Notify();
+
+    bool HasWaiters() const {
+        return !fds_.empty();
+    }
+
+    // The epoll fd: readable while Poll() has something to report,
+    // for a host loop that waits on its own.
+    int GetFd() const {
+        return epoll_fd_;
+    }
+
+private:
+    struct Interest {
+        FdAwaitable* reader = nullptr;
+        FdAwaitable* writer = nullptr;
+    };
+
+    void Update(int fd, const Interest& interest, int op);
+
+private:
+    int epoll_fd_ = -1;
+    int event_fd_ = -1;
+    std::unordered_map<int, Interest> fds_;
+};
+
+}  // namespace lines
@@ -0,0 +1,58 @@
+#include <lines/std/async_condvar.hpp>
+
+#ifndef LINES_THREADS
+
+#include <lines/fibers/scheduler.hpp>
+
+#include <libassert/assert.hpp>
+
+namespace lines {
+
+std::coroutine_handle<> AsyncCondvar::WaitAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    condvar_->waiters_.Append(this);
+    waiting_ = true;
+
+    // The next owner of the mutex runs right away.
+    if (auto next = mutex_->Release()) {
+        return next->handle_;
+    }
+    return std::noop_coroutine();
+}
+
+bool AsyncCondvar::WaitAwaiter::Cancel() {
+    if (!waiting_) {
+        return false;
+    }
+
+    condvar_->waiters_.Remove(this);
+    condvar_->Notify(this);
+    return true;
+}
+
+AsyncCondvar::~AsyncCondvar() {
+    ASSERT(waiters_.Empty());
+}
+
+void AsyncCondvar::NotifyOne() {
+    if (auto waiter = waiters_.PopFront()) {
+        Notify(waiter);
+    }
+}
+
+void AsyncCondvar::NotifyAll() {
+    while (auto waiter = waiters_.PopFront()) {
+        Notify(waiter);
+    }
+}
+
+void AsyncCondvar::Notify(AsyncMutex::LockAwaiter* waiter) {
+    static_cast<WaitAwaiter*>(waiter)->waiting_ = false;
+    if (waiter->mutex_->LockOrEnqueue(waiter)) {
+        Scheduler::This().Schedule(waiter->handle_);
+    }
+}
+
+}  // namespace lines
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef LINES_THREADS
+
+#include <lines/std/async_mutex.hpp>
+
+#include <coroutine>
+
+namespace lines {
+
+// Condition variable for coroutines holding an AsyncMutex.
+// A notified waiter is moved straight into the mutex queue,
+// so it is resumed only once it owns the mutex again.
+//
+//   co_await mutex.Lock();
+//   while (!ready) {
+//       co_await condvar.Wait(mutex);
+//   }
+//   mutex.Unlock();
+class AsyncCondvar {
+public:
+    class WaitAwaiter : public AsyncMutex::LockAwaiter {
+    public:
+        WaitAwaiter(AsyncCondvar& condvar, AsyncMutex& mutex)
+            : AsyncMutex::LockAwaiter(mutex), condvar_(&condvar) {
+        }
+
+        bool await_ready() noexcept {
+            return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle);
+
+        // Stops waiting for a notification. The coroutine is resumed once it
+        // owns the mutex again, as after a spurious wakeup.
+        // Returns false if the waiter has already been notified.
+        bool Cancel();
+
+    private:
+        friend class AsyncCondvar;
+
+        AsyncCondvar* condvar_;
+        bool waiting_ = false;
+    };
+
+public:
+    AsyncCondvar() = default;
+    ~AsyncCondvar();
+
+    AsyncCondvar(const AsyncCondvar&) = delete;
+    AsyncCondvar& operator=(const AsyncCondvar&) = delete;
+
+    // Releases the mutex, which must be held, and waits for a notification.
+    [[nodiscard]] WaitAwaiter Wait(AsyncMutex& mutex) {
+        return WaitAwaiter(*this, mutex);
+    }
+
+    void NotifyOne();
+    void NotifyAll();
+
+private:
+    void Notify(AsyncMutex::LockAwaiter* waiter);
+
+private:
+    IntrusiveList<AsyncMutex::LockAwaiter> waiters_;
+};
+
+}  // namespace lines
+
+#endif
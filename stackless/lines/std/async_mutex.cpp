@@ -0,0 +1,86 @@
+#include <lines/std/async_mutex.hpp>
+
+#ifndef LINES_THREADS
+
+#include <lines/fibers/scheduler.hpp>
+
+#include <libassert/assert.hpp>
+
+namespace lines {
+
+bool AsyncMutex::LockAwaiter::await_ready() {
+    return mutex_->TryLock();
+}
+
+bool AsyncMutex::LockAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    return !mutex_->LockOrEnqueue(this);
+}
+
+bool AsyncMutex::LockAwaiter::Cancel() {
+    if (!parked_) {
+        return false;
+    }
+
+    mutex_->waiters_.Remove(this);
+    parked_ = false;
+    Scheduler::This().Schedule(handle_);
+    return true;
+}
+
+bool AsyncMutex::UnlockAwaiter::await_ready() {
+    if (mutex_->waiters_.Empty()) {
+        mutex_->Unlock();
+        return true;
+    }
+    return false;
+}
+
+std::coroutine_handle<> AsyncMutex::UnlockAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    Scheduler::This().Schedule(handle);
+    return mutex_->Release()->handle_;
+}
+
+AsyncMutex::~AsyncMutex() {
+    ASSERT(!locked_);
+    ASSERT(waiters_.Empty());
+}
+
+bool AsyncMutex::TryLock() {
+    if (locked_) {
+        return false;
+    }
+    locked_ = true;
+    return true;
+}
+
+void AsyncMutex::Unlock() {
+    if (auto next = Release()) {
+        Scheduler::This().Schedule(next->handle_);
+    }
+}
+
+bool AsyncMutex::LockOrEnqueue(LockAwaiter* waiter) {
+    if (TryLock()) {
+        return true;
+    }
+    waiters_.Append(waiter);
+    waiter->parked_ = true;
+    return false;
+}
+
+AsyncMutex::LockAwaiter* AsyncMutex::Release() {
+    ASSERT(locked_);
+
+    auto next = waiters_.PopFront();
+    if (next) {
+        next->parked_ = false;
+    } else {
+        locked_ = false;
+    }
+    return next;
+}
+
+}  // namespace lines
+
+#endif
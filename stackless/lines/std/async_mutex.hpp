@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef LINES_THREADS
+
+#include <lines/util/intrusive_list.hpp>
+#include <lines/util/intrusive_node.hpp>
+
+#include <coroutine>
+
+namespace lines {
+
+class AsyncCondvar;
+
+// Mutex for stackless coroutines scheduled by the current Scheduler.
+// Waiters are parked in nodes stored inside their awaiters, so locking
+// never allocates. Unlocking hands ownership directly to the next waiter.
+//
+//   co_await mutex.Lock();
+//   ...
+//   mutex.Unlock();
+class AsyncMutex {
+public:
+    class LockAwaiter : public IntrusiveNode<LockAwaiter> {
+    public:
+        explicit LockAwaiter(AsyncMutex& mutex) : mutex_(&mutex) {
+        }
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {
+        }
+
+        // Leaves the queue and resumes the coroutine without the lock.
+        // Returns false if the lock has already been handed over.
+        bool Cancel();
+
+    private:
+        friend class AsyncMutex;
+        friend class AsyncCondvar;
+
+        AsyncMutex* mutex_;
+        std::coroutine_handle<> handle_{};
+        bool parked_ = false;
+    };
+
+    class UnlockAwaiter {
+    public:
+        explicit UnlockAwaiter(AsyncMutex& mutex) : mutex_(&mutex) {
+        }
+
+        bool await_ready();
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {
+        }
+
+    private:
+        AsyncMutex* mutex_;
+    };
+
+public:
+    AsyncMutex() = default;
+    ~AsyncMutex();
+
+    AsyncMutex(const AsyncMutex&) = delete;
+    AsyncMutex& operator=(const AsyncMutex&) = delete;
+
+    [[nodiscard]] LockAwaiter Lock() {
+        return LockAwaiter(*this);
+    }
+
+    bool TryLock();
+
+    // Passes ownership to the next waiter and schedules it.
+    void Unlock();
+
+    // Passes ownership to the next waiter and switches to it right away,
+    // the awaiting coroutine is scheduled: `co_await mutex.UnlockAndSwitch();`.
+    [[nodiscard]] UnlockAwaiter UnlockAndSwitch() {
+        return UnlockAwaiter(*this);
+    }
+
+private:
+    friend class AsyncCondvar;
+
+    // Either acquires the free mutex for the waiter and returns true,
+    // or queues the waiter.
+    bool LockOrEnqueue(LockAwaiter* waiter);
+
+    // Releases the mutex or makes the next waiter its owner.
+    // Returns the new owner, if any.
+    LockAwaiter* Release();
+
+private:
+    bool locked_ = false;
+    IntrusiveList<LockAwaiter> waiters_;
+};
+
+}  // namespace lines
+
+#endif
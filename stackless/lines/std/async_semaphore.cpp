@@ -0,0 +1,55 @@
+#include <lines/std/async_semaphore.hpp>
+
+#ifndef LINES_THREADS
+
+#include <lines/fibers/scheduler.hpp>
+
+#include <libassert/assert.hpp>
+
+namespace lines {
+
+bool AsyncSemaphore::AcquireAwaiter::await_ready() {
+    return semaphore_->TryAcquire();
+}
+
+void AsyncSemaphore::AcquireAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    semaphore_->waiters_.Append(this);
+    parked_ = true;
+}
+
+bool AsyncSemaphore::AcquireAwaiter::Cancel() {
+    if (!parked_) {
+        return false;
+    }
+
+    semaphore_->waiters_.Remove(this);
+    parked_ = false;
+    Scheduler::This().Schedule(handle_);
+    return true;
+}
+
+AsyncSemaphore::~AsyncSemaphore() {
+    ASSERT(waiters_.Empty());
+}
+
+bool AsyncSemaphore::TryAcquire() {
+    if (permits_ == 0) {
+        return false;
+    }
+    --permits_;
+    return true;
+}
+
+void AsyncSemaphore::Release() {
+    if (auto waiter = waiters_.PopFront()) {
+        waiter->parked_ = false;
+        Scheduler::This().Schedule(waiter->handle_);
+    } else {
+        ++permits_;
+    }
+}
+
+}  // namespace lines
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef LINES_THREADS
+
+#include <lines/util/intrusive_list.hpp>
+#include <lines/util/intrusive_node.hpp>
+
+#include <coroutine>
+#include <cstddef>
+
+namespace lines {
+
+// Counting semaphore for stackless coroutines scheduled by the current Scheduler.
+// A released permit is handed directly to the first waiter.
+//
+//   co_await semaphore.Acquire();
+//   ...
+//   semaphore.Release();
+class AsyncSemaphore {
+public:
+    class AcquireAwaiter : public IntrusiveNode<AcquireAwaiter> {
+    public:
+        explicit AcquireAwaiter(AsyncSemaphore& semaphore) : semaphore_(&semaphore) {
+        }
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {
+        }
+
+        // Leaves the queue and resumes the coroutine without a permit.
+        // Returns false if a permit has already been handed over.
+        bool Cancel();
+
+    private:
+        friend class AsyncSemaphore;
+
+        AsyncSemaphore* semaphore_;
+        std::coroutine_handle<> handle_{};
+        bool parked_ = false;
+    };
+
+public:
+    explicit AsyncSemaphore(size_t permits) : permits_(permits) {
+    }
+    ~AsyncSemaphore();
+
+    AsyncSemaphore(const AsyncSemaphore&) = delete;
+    AsyncSemaphore& operator=(const AsyncSemaphore&) = delete;
+
+    [[nodiscard]] AcquireAwaiter Acquire() {
+        return AcquireAwaiter(*this);
+    }
+
+    bool TryAcquire();
+    void Release();
+
+    size_t Available() const {
+        return permits_;
+    }
+
+private:
+    size_t permits_;
+    IntrusiveList<AcquireAwaiter> waiters_;
+};
+
+}  // namespace lines
+
+#endif
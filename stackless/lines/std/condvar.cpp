@@ -47,14 +47,17 @@ void Condvar::NotifyAll() {
     InjectFault();
 }
 
-void Condvar::StartWait() {
+// A notification sent after the lock is released, but before the waiter
+// has switched away, changes the epoch and is not lost.
+uint64_t Condvar::StartWait() {
     InjectFault();
 
     DisableInjection();
+    return fibers_.Epoch();
 }
 
-void Condvar::Suspend() {
-    Scheduler::This().Suspend(&fibers_);
+void Condvar::Suspend(uint64_t epoch) {
+    fibers_.Wait(epoch);
 }
 
 void Condvar::EndWait() {
@@ -31,6 +31,8 @@ private:
 
 #include <lines/sync/wait_queue.hpp>
 
+#include <cstdint>
+
 namespace lines {
 
 class Condvar {
@@ -39,9 +41,9 @@ public:
 
     template <class Lockable>
     void Wait(Lockable& lock) {
-        StartWait();
+        auto epoch = StartWait();
         lock.unlock();
-        Suspend();
+        Suspend(epoch);
         lock.lock();
         EndWait();
     }
@@ -50,8 +52,8 @@ public:
     void NotifyAll();
 
 private:
-    void StartWait();
-    void Suspend();
+    uint64_t StartWait();
+    void Suspend(uint64_t epoch);
     void EndWait();
 
 private:
@@ -41,28 +41,32 @@ Mutex::~Mutex() {
 
 void Mutex::Lock() {
     InjectFault();
-    while (owner_) {
-        Scheduler::This().Suspend(&fibers_);
+    auto running = Fiber::This();
+    while (true) {
+        // The owner may unlock on another worker while we are switching away
+        auto epoch = fibers_.Epoch();
+        Fiber* expected = nullptr;
+        if (owner_.compare_exchange_strong(expected, running)) {
+            break;
+        }
+        fibers_.Wait(epoch);
     }
-
-    owner_ = Fiber::This();
     InjectFault();
 }
 
 bool Mutex::TryLock() {
     InjectFault();
     auto running = Fiber::This();
-    if (!owner_) {
-        owner_ = running;
-    }
+    Fiber* expected = nullptr;
+    bool locked = owner_.compare_exchange_strong(expected, running) || expected == running;
     InjectFault();
 
-    return owner_ == running;
+    return locked;
 }
 
 void Mutex::Unlock() {
     InjectFault();
-    owner_ = nullptr;
+    owner_.store(nullptr);
     fibers_.WakeOne();
     InjectFault();
 }
@@ -29,6 +29,8 @@ private:
 
 #include <lines/sync/wait_queue.hpp>
 
+#include <atomic>
+
 namespace lines {
 
 class Mutex {
@@ -47,7 +49,7 @@ public:
 
 private:
     WaitQueue fibers_;
-    Fiber* owner_ = nullptr;
+    std::atomic<Fiber*> owner_{nullptr};
 };
 
 }  // namespace lines
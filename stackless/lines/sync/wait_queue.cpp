@@ -5,35 +5,89 @@
 
 #include <libassert/assert.hpp>
 
+#include <mutex>
+
 namespace lines {
 
+namespace {
+
+void Wake(Fiber* fiber) {
+    ASSERT(fiber->GetState() == Fiber::State::Suspended);
+    fiber->SetState(Fiber::State::Runnable);
+    Scheduler::This().Schedule(fiber);
+}
+
+}  // namespace
+
+class EpochParker : public IAwaitable {
+public:
+    EpochParker(WaitQueue* queue, uint64_t epoch) : queue_(queue), epoch_(epoch) {
+    }
+
+    void Park(Fiber* fiber) override {
+        queue_->ParkIf(fiber, epoch_);
+    }
+
+private:
+    WaitQueue* queue_;
+    uint64_t epoch_;
+};
+
 void WaitQueue::Park(Fiber* fiber) {
     ASSERT(fiber->GetState() == Fiber::State::Suspended);
-    fibers_.Prepend(fiber);
+    std::lock_guard guard(lock_);
+    fibers_.Append(fiber);
+}
+
+void WaitQueue::Wait(uint64_t epoch) {
+    EpochParker parker(this, epoch);
+    Scheduler::This().Suspend(&parker);
+}
+
+void WaitQueue::ParkIf(Fiber* fiber, uint64_t epoch) {
+    {
+        std::lock_guard guard(lock_);
+        if (epoch_.load(std::memory_order::relaxed) == epoch) {
+            fibers_.Append(fiber);
+            return;
+        }
+    }
+
+    // Missed a wakeup while switching away
+    Wake(fiber);
 }
 
 void WaitQueue::WakeOne() {
-    auto fiber = fibers_.PickRandom();
-    if (!fiber) {
-        return;
+    Fiber* fiber = nullptr;
+    {
+        std::lock_guard guard(lock_);
+        epoch_.fetch_add(1, std::memory_order::seq_cst);
+
+        // Waiters are woken in arrival order, unless the scheduler randomizes
+        bool random = Scheduler::This().GetRunPolicy() == RunPolicy::Random;
+        fiber = random ? fibers_.PickRandom() : fibers_.Head();
+        if (fiber) {
+            fibers_.Remove(fiber);
+        }
     }
-    ASSERT(fiber->GetState() == Fiber::State::Suspended);
 
-    fibers_.Remove(fiber);
-    fiber->SetState(Fiber::State::Runnable);
-    Scheduler::This().Schedule(fiber);
+    if (fiber) {
+        Wake(fiber);
+    }
 }
 
 void WaitQueue::WakeAll() {
-    Fiber* next = nullptr;
-    for (Fiber* fiber = fibers_.Head(); fiber; fiber = next) {
-        ASSERT(fiber->GetState() == Fiber::State::Suspended);
-
-        next = fiber->Next();
+    FiberQueue woken;
+    {
+        std::lock_guard guard(lock_);
+        epoch_.fetch_add(1, std::memory_order::seq_cst);
+        while (auto fiber = fibers_.PopFront()) {
+            woken.Append(fiber);
+        }
+    }
 
-        fibers_.Remove(fiber);
-        fiber->SetState(Fiber::State::Runnable);
-        Scheduler::This().Schedule(fiber);
+    while (auto fiber = woken.PopFront()) {
+        Wake(fiber);
     }
 }
 
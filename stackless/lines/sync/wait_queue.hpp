@@ -2,12 +2,30 @@
 
 #include <lines/fibers/queue.hpp>
 #include <lines/sync/awaitable.hpp>
+#include <lines/util/spinlock.hpp>
+
+#include <atomic>
+#include <cstdint>
 
 namespace lines {
 
+// Fibers waiting for a condition, safe to wake from any worker of a pool.
+//
+// Parking happens once the fiber has switched away, on the scheduler context
+// or on the next fiber, so a waiter reads Epoch() before checking its
+// condition and passes it to Wait(): a wakeup in between makes Wait() return
+// right away, like a futex.
 class WaitQueue : public IAwaitable {
 public:
     void Park(Fiber* fiber) override;
+
+    uint64_t Epoch() const {
+        return epoch_.load(std::memory_order::seq_cst);
+    }
+
+    // Suspends the running fiber unless some fiber was woken since `epoch`.
+    void Wait(uint64_t epoch);
+
     void WakeOne();
     void WakeAll();
 
@@ -18,7 +36,14 @@ public:
     ~WaitQueue();
 
 private:
+    friend class EpochParker;
+
+    void ParkIf(Fiber* fiber, uint64_t epoch);
+
+private:
+    SpinLock lock_;
     FiberQueue fibers_;
+    std::atomic<uint64_t> epoch_{0};
 };
 
 }  // namespace lines
@@ -0,0 +1,54 @@
+#include <lines/time/awaitable.hpp>
+
+#ifdef LINES_THREADS
+
+#include <thread>
+
+namespace lines {
+
+bool SleepAwaitable::await_ready() {
+    std::this_thread::sleep_until(timer_.GetTimepoint());
+    return true;
+}
+
+void SleepAwaitable::await_suspend(std::coroutine_handle<>) {
+}
+
+bool SleepAwaitable::Cancel() {
+    return false;
+}
+
+}  // namespace lines
+
+#else
+
+#include <lines/fibers/scheduler.hpp>
+
+namespace lines {
+
+bool SleepAwaitable::await_ready() {
+    return false;
+}
+
+void SleepAwaitable::await_suspend(std::coroutine_handle<> handle) {
+    Scheduler::This().Sleep(&timer_, handle);
+}
+
+bool SleepAwaitable::Cancel() {
+    return Scheduler::This().CancelTimer(&timer_);
+}
+
+}  // namespace lines
+
+#endif
+
+namespace lines {
+
+SleepAwaitable::SleepAwaitable(const Timepoint& deadline) : timer_(deadline) {
+}
+
+SleepAwaitable SleepForAsync(const Duration& duration) {
+    return SleepAwaitable(Now() + duration);
+}
+
+}  // namespace lines
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <lines/time/api.hpp>
+#include <lines/time/timer.hpp>
+
+#include <coroutine>
+
+namespace lines {
+
+// Suspends the awaiting coroutine until the deadline,
+// without occupying a fiber: `co_await lines::SleepForAsync(10ms);`.
+class SleepAwaitable {
+public:
+    explicit SleepAwaitable(const Timepoint& deadline);
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() noexcept {
+    }
+
+    // Wakes the sleeping coroutine early, returns false if it has already woken.
+    bool Cancel();
+
+private:
+    Timer timer_;
+};
+
+SleepAwaitable SleepForAsync(const Duration& duration);
+
+}  // namespace lines
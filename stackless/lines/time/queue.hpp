@@ -1,39 +1,12 @@
 #pragma once
 
-#include <queue>
-
-#include <lines/fibers/fiber.hpp>
 #include <lines/time/timer.hpp>
+#include <lines/util/indexed_heap.hpp>
 
 namespace lines {
 
-class TimerQueue {
-public:
-    void Add(Timer* timer) {
-        timers_.emplace(timer);
-    }
-
-    bool Empty() {
-        return timers_.empty();
-    }
-
-    Timer* Top() const {
-        return timers_.top();
-    }
-
-    void Pop() {
-        timers_.pop();
-    }
-
-private:
-    struct Comparator {
-        bool operator()(Timer* lhs, Timer* rhs) {
-            return *lhs < *rhs;
-        }
-    };
-
-private:
-    std::priority_queue<Timer*, std::vector<Timer*>, Comparator> timers_;
-};
+// Timers by deadline. Every queued timer knows its position,
+// so a timer may be removed before its deadline.
+using TimerQueue = IndexedHeap<Timer>;
 
 }  // namespace lines
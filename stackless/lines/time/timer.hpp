@@ -2,6 +2,11 @@
 
 #include <lines/sync/awaitable.hpp>
 #include <lines/time/api.hpp>
+#include <lines/util/indexed_heap.hpp>
+
+#include <coroutine>
+#include <cstddef>
+#include <utility>
 
 namespace lines {
 
@@ -21,17 +26,36 @@ public:
         return fiber;
     }
 
-    bool operator<(const Timer& timer) {
+    void Park(std::coroutine_handle<> handle) {
+        handle_ = handle;
+    }
+    std::coroutine_handle<> UnparkCoroutine() {
+        return std::exchange(handle_, {});
+    }
+
+    bool operator<(const Timer& timer) const {
         return timepoint_ < timer.timepoint_;
     }
 
+    const Timepoint& GetTimepoint() const {
+        return timepoint_;
+    }
+
     bool CompareWithTimepoint(const Timepoint& timepoint) {
         return timepoint_ <= timepoint;
     }
 
+    bool IsQueued() const {
+        return heap_index_ != kNotInHeap;
+    }
+
 private:
+    friend class IndexedHeap<Timer>;
+
     Timepoint timepoint_;
     Fiber* fiber_ = nullptr;
+    std::coroutine_handle<> handle_{};
+    size_t heap_index_ = kNotInHeap;
 };
 
 }  // namespace lines
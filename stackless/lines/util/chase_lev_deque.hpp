@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lines {
+
+// Work-stealing deque (Chase & Lev, with the memory orderings of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owner pushes and pops at the bottom, thieves steal from the top.
+template <class T>
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(size_t capacity = 256) : buffer_(new Buffer(capacity)) {
+        buffers_.emplace_back(buffer_.load(std::memory_order::relaxed));
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // Owner only.
+    void Push(T* item) {
+        auto bottom = bottom_.load(std::memory_order::relaxed);
+        auto top = top_.load(std::memory_order::acquire);
+        auto buffer = buffer_.load(std::memory_order::relaxed);
+        if (bottom - top >= static_cast<int64_t>(buffer->Capacity())) {
+            buffer = Grow(buffer, top, bottom);
+        }
+
+        buffer->Put(bottom, item);
+        std::atomic_thread_fence(std::memory_order::release);
+        bottom_.store(bottom + 1, std::memory_order::relaxed);
+    }
+
+    // Owner only, returns the most recently pushed item.
+    T* Pop() {
+        auto bottom = bottom_.load(std::memory_order::relaxed) - 1;
+        auto buffer = buffer_.load(std::memory_order::relaxed);
+        bottom_.store(bottom, std::memory_order::relaxed);
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        auto top = top_.load(std::memory_order::relaxed);
+
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order::relaxed);
+            return nullptr;
+        }
+
+        T* item = buffer->Get(bottom);
+        if (top == bottom) {
+            // The last item, race with the thieves for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order::seq_cst,
+                                              std::memory_order::relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order::relaxed);
+        }
+        return item;
+    }
+
+    // Any thread, returns the oldest item or nullptr if empty or contended.
+    T* Steal() {
+        auto top = top_.load(std::memory_order::acquire);
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        auto bottom = bottom_.load(std::memory_order::acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+
+        T* item = buffer_.load(std::memory_order::acquire)->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order::seq_cst,
+                                          std::memory_order::relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate when called concurrently with the owner.
+    size_t Size() const {
+        auto bottom = bottom_.load(std::memory_order::relaxed);
+        auto top = top_.load(std::memory_order::relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+private:
+    class Buffer {
+    public:
+        explicit Buffer(size_t capacity)
+            : mask_(capacity - 1), slots_(new std::atomic<T*>[capacity]) {
+        }
+
+        size_t Capacity() const {
+            return mask_ + 1;
+        }
+
+        T* Get(int64_t index) const {
+            return slots_[index & mask_].load(std::memory_order::relaxed);
+        }
+
+        void Put(int64_t index, T* item) {
+            slots_[index & mask_].store(item, std::memory_order::relaxed);
+        }
+
+    private:
+        size_t mask_;
+        std::unique_ptr<std::atomic<T*>[]> slots_;
+    };
+
+    // Thieves may still read the old buffer, so it is kept until destruction.
+    Buffer* Grow(Buffer* buffer, int64_t top, int64_t bottom) {
+        auto grown = new Buffer(buffer->Capacity() * 2);
+        for (auto index = top; index < bottom; ++index) {
+            grown->Put(index, buffer->Get(index));
+        }
+        buffers_.emplace_back(grown);
+        buffer_.store(grown, std::memory_order::release);
+        return grown;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Buffer*> buffer_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+}  // namespace lines
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace lines {
+
+inline constexpr size_t kNotInHeap = static_cast<size_t>(-1);
+
+// Binary min-heap of pointers. Every element knows its position in
+// `heap_index_` (kNotInHeap when not queued), so it may be removed or
+// re-sifted after its key changes. T must befriend IndexedHeap<T>
+// and be ordered by operator<.
+template <class T>
+class IndexedHeap {
+public:
+    void Add(T* item) {
+        item->heap_index_ = items_.size();
+        items_.push_back(item);
+        SiftUp(item->heap_index_);
+    }
+
+    bool Empty() const {
+        return items_.empty();
+    }
+
+    size_t Size() const {
+        return items_.size();
+    }
+
+    T* Top() const {
+        return items_.front();
+    }
+
+    void Pop() {
+        Remove(items_.front());
+    }
+
+    void Remove(T* item) {
+        size_t index = item->heap_index_;
+        item->heap_index_ = kNotInHeap;
+
+        T* last = items_.back();
+        items_.pop_back();
+        if (last == item) {
+            return;
+        }
+
+        Place(last, index);
+        Update(last);
+    }
+
+    // Restores the order after the key of a queued item has changed.
+    void Update(T* item) {
+        SiftUp(item->heap_index_);
+        SiftDown(item->heap_index_);
+    }
+
+private:
+    void Place(T* item, size_t index) {
+        items_[index] = item;
+        item->heap_index_ = index;
+    }
+
+    void SiftUp(size_t index) {
+        T* item = items_[index];
+        while (index > 0) {
+            size_t parent = (index - 1) / 2;
+            if (!(*item < *items_[parent])) {
+                break;
+            }
+            Place(items_[parent], index);
+            index = parent;
+        }
+        Place(item, index);
+    }
+
+    void SiftDown(size_t index) {
+        T* item = items_[index];
+        while (true) {
+            size_t child = 2 * index + 1;
+            if (child >= items_.size()) {
+                break;
+            }
+            if (child + 1 < items_.size() && *items_[child + 1] < *items_[child]) {
+                ++child;
+            }
+            if (!(*items_[child] < *item)) {
+                break;
+            }
+            Place(items_[child], index);
+            index = child;
+        }
+        Place(item, index);
+    }
+
+private:
+    std::vector<T*> items_;
+};
+
+}  // namespace lines
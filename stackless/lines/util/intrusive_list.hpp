@@ -13,25 +13,73 @@ public:
         if (head_) {
             obj->next = head_;
             head_->prev = obj;
+        } else {
+            tail_ = obj;
         }
 
         head_ = obj;
         ++size_;
     }
 
+    void Append(T* obj) {
+        if (tail_) {
+            obj->prev = tail_;
+            tail_->next = obj;
+        } else {
+            head_ = obj;
+        }
+
+        tail_ = obj;
+        ++size_;
+    }
+
+    // Moves all the elements of `other` to the back of the list in O(1).
+    void Splice(IntrusiveList& other) {
+        if (other.Empty()) {
+            return;
+        }
+
+        if (tail_) {
+            tail_->next = other.head_;
+            other.head_->prev = tail_;
+        } else {
+            head_ = other.head_;
+        }
+
+        tail_ = other.tail_;
+        size_ += other.size_;
+        other.head_ = other.tail_ = nullptr;
+        other.size_ = 0;
+    }
+
     void Remove(T* obj) {
         if (obj == head_) {
             head_ = obj->next;
         }
+        if (obj == tail_) {
+            tail_ = obj->prev;
+        }
 
         obj->Unlink();
         --size_;
     }
 
+    T* PopFront() {
+        T* obj = head_;
+        if (obj) {
+            Remove(obj);
+        }
+        return obj;
+    }
+
     T* Head() {
         return head_;
     }
 
+    T* Tail() {
+        return tail_;
+    }
+
     bool Empty() const {
         return head_ == nullptr;
     }
@@ -42,6 +90,7 @@ public:
 
 private:
     T* head_ = nullptr;
+    T* tail_ = nullptr;
     size_t size_ = 0;
 };
 
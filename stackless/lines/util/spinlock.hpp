@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+namespace lines {
+
+// Test-and-test-and-set lock for short critical sections shared by the
+// workers of a SchedulerPool. Never suspends the fiber.
+class SpinLock {
+public:
+    void Lock() {
+        while (locked_.exchange(true, std::memory_order::acquire)) {
+            while (locked_.load(std::memory_order::relaxed)) {
+                __builtin_ia32_pause();
+            }
+        }
+    }
+
+    bool TryLock() {
+        return !locked_.load(std::memory_order::relaxed) &&
+               !locked_.exchange(true, std::memory_order::acquire);
+    }
+
+    void Unlock() {
+        locked_.store(false, std::memory_order::release);
+    }
+
+    void lock() {  // NOLINT
+        Lock();
+    }
+
+    bool try_lock() {  // NOLINT
+        return TryLock();
+    }
+
+    void unlock() {  // NOLINT
+        Unlock();
+    }
+
+private:
+    std::atomic<bool> locked_{false};
+};
+
+}  // namespace lines
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace lines {
+
+// Unbounded single-producer single-consumer queue of linked nodes.
+// The consumer keeps a drained node as the head, so the two ends never
+// touch the same pointer.
+template <class T>
+class SpscQueue {
+public:
+    SpscQueue() : head_(new Node), tail_(head_) {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue() {
+        while (head_) {
+            delete std::exchange(head_, head_->next.load(std::memory_order::relaxed));
+        }
+    }
+
+    // Producer only.
+    void Push(T value) {
+        auto node = new Node{std::move(value)};
+        tail_->next.store(node, std::memory_order::release);
+        tail_ = node;
+    }
+
+    // Consumer only.
+    std::optional<T> Pop() {
+        auto next = head_->next.load(std::memory_order::acquire);
+        if (!next) {
+            return std::nullopt;
+        }
+
+        auto value = std::exchange(next->value, std::nullopt);
+        delete std::exchange(head_, next);
+        return value;
+    }
+
+    // Consumer only.
+    bool Empty() const {
+        return head_->next.load(std::memory_order::acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        std::optional<T> value;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    alignas(64) Node* head_;
+    alignas(64) Node* tail_;
+};
+
+}  // namespace lines
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stackless/async_task.hpp>
+
+#include <coroutine>
+#include <expected>
+#include <type_traits>
+#include <utility>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Class declarations
+////////////////////////////////////////////////////////////////////////////////
+
+/// Value or error of a task that reports failures without exceptions:
+/// `AsyncTask<Result<T, E>>` returns errors with `co_return Err(e)`.
+template <class T, class E>
+using Result = std::expected<T, E>;
+
+/// Error of a Result: `co_return Err(code);`.
+template <class E>
+std::unexpected<std::decay_t<E>> Err(E&& error) {
+    return std::unexpected<std::decay_t<E>>(std::forward<E>(error));
+}
+
+namespace detail {
+
+template <class R>
+struct IsResult : std::false_type {};
+
+template <class T, class E>
+struct IsResult<Result<T, E>> : std::true_type {};
+
+/// Awaits a task returning Result. On error the awaiting coroutine is not
+/// resumed: it completes with the error right away, like `?` in Rust.
+///
+/// The check is made when the child completes, before the symmetric transfer
+/// to the awaiting coroutine, so errors never touch the exception machinery.
+template <class T, class E>
+class TryAwaiter : public CompletionWaiter {
+public:
+    explicit TryAwaiter(AsyncTask<Result<T, E>>&& task) : task_(std::move(task)) {
+        if (!task_.IsValid()) {
+            throw AsyncTaskInvalid();
+        }
+    }
+
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    template <class R>
+        requires IsResult<R>::value
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<AsyncTaskPromise<R>> awaiting) noexcept {
+        awaiting_ = awaiting;
+        fail_ = &Fail<R>;
+
+        auto child = AsyncTaskAccess::GetHandle(task_);
+        child.promise().InheritCancellationToken(awaiting.promise().GetCancellationToken());
+        child.promise().GetCompletion().Subscribe(this);
+        return child;
+    }
+
+    std::coroutine_handle<> OnComplete(std::coroutine_handle<>) noexcept override {
+        // Exceptions are rethrown in the awaiting coroutine as usual
+        auto result = AsyncTaskAccess::GetHandle(task_).promise().PeekValue();
+        if (!result || result->has_value()) {
+            return awaiting_;
+        }
+        return fail_(this);
+    }
+
+    T await_resume() {
+        auto result = AsyncTaskAccess::GetHandle(task_).promise().GetResult();
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*result);
+        }
+    }
+
+#ifdef CORO_FRAME_PROFILER
+    ~TryAwaiter() {
+        if (task_.IsValid()) {
+            MarkFrameAwaited(AsyncTaskAccess::GetHandle(task_).address());
+        }
+    }
+#endif
+
+private:
+    // Moves the error into the awaiting coroutine and completes it. The
+    // awaiter lives in that frame and may be destroyed, so it is not used after.
+    template <class R>
+    static std::coroutine_handle<> Fail(TryAwaiter* self) noexcept {
+        auto awaiting = std::coroutine_handle<AsyncTaskPromise<R>>::from_address(
+            self->awaiting_.address());
+        auto& error = AsyncTaskAccess::GetHandle(self->task_).promise().PeekValue()->error();
+        awaiting.promise().return_value(std::unexpected<typename R::error_type>(std::move(error)));
+        return awaiting.promise().Finish(awaiting);
+    }
+
+private:
+    AsyncTask<Result<T, E>> task_;
+    std::coroutine_handle<> awaiting_{};
+    std::coroutine_handle<> (*fail_)(TryAwaiter*) noexcept = nullptr;
+};
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+// Methods declarations
+////////////////////////////////////////////////////////////////////////////////
+
+/// Awaits the task and returns its value. If the task returns an error, the
+/// awaiting task returns it as well, without resuming:
+///
+///   AsyncTask<Result<Page, Errc>> Load(Id id) {
+///       auto meta = co_await Try(LoadMeta(id));
+///       co_return co_await Try(LoadPage(meta));
+///   }
+///
+/// The awaiting task must return a Result whose error is constructible from `E`.
+///
+/// Preconditions:
+/// - `IsValid() == true` (else throws AsyncTaskInvalid)
+template <class T, class E>
+[[nodiscard]] detail::TryAwaiter<T, E> Try(AsyncTask<Result<T, E>> task) {
+    return detail::TryAwaiter<T, E>(std::move(task));
+}
+
+}  // namespace coro
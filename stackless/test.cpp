@@ -1,14 +1,53 @@
 #include <catch2/catch_all.hpp>
 
 #include <lines/fibers/api.hpp>
+#include <lines/fibers/pool.hpp>
+#include <lines/fibers/scheduler.hpp>
+#include <lines/fibers/shards.hpp>
+#include <lines/io/api.hpp>
+#include <lines/std/condvar.hpp>
+#include <lines/std/mutex.hpp>
+#include <lines/std/async_condvar.hpp>
+#include <lines/std/async_mutex.hpp>
+#include <lines/std/async_semaphore.hpp>
+#include <lines/sync/wait_queue.hpp>
+#include <lines/time/awaitable.hpp>
 
+#include <lines/util/clock.hpp>
+#include <lines/util/defer.hpp>
 #include <lines/util/move_only.hpp>
+#include <lines/util/thread_local.hpp>
 #include <lines/util/compiler.hpp>
 
+#include <stackless/async_generator.hpp>
 #include <stackless/async_task.hpp>
+#include <stackless/cancellation.hpp>
+#include <stackless/frame_profiler.hpp>
+#include <stackless/generator.hpp>
+#include <stackless/result.hpp>
+#include <stackless/when_all.hpp>
 
 #include <libassert/assert.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct MoveOnlyInt : public lines::MoveOnly {
@@ -173,3 +212,1717 @@ TEST_CASE("CoroIsDestroyedAfterFinishingExecution") {
     });
 }
 ////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("FramesArePooled") {
+    lines::SchedulerRun([] {
+        constexpr int64_t kIterCount = 10'000;
+
+        auto inner_coro = [](int64_t index) -> coro::AsyncTask<int64_t> {
+            std::array<int, 1000> arr;
+            lines::DoNotOptimize(arr);
+            co_return index;
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<int64_t> {
+            int64_t result = 0;
+            for (int i = 0; i < kIterCount; ++i) {
+                result += co_await inner_coro(i);
+            }
+            co_return result;
+        };
+
+        auto before = coro::GetFramePoolStats();
+        REQUIRE(coro().Run().get() == (kIterCount * (kIterCount - 1)) / 2);
+        auto after = coro::GetFramePoolStats();
+
+        REQUIRE(after.hits - before.hits >= kIterCount - 1);
+        REQUIRE(after.misses - before.misses <= 2);
+    });
+}
+
+struct ManualSuspend {
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        *slot = handle;
+    }
+
+    void await_resume() noexcept {
+    }
+
+    std::coroutine_handle<>* slot;
+};
+
+TEST_CASE("FutureParksFiber") {
+    lines::SchedulerRun([] {
+        std::coroutine_handle<> suspended;
+        auto coro = [&]() -> coro::AsyncTask<int> {
+            co_await ManualSuspend{&suspended};
+            co_return 7;
+        };
+
+        auto future = coro().Run();
+        REQUIRE(future.IsValid());
+        REQUIRE_FALSE(future.IsReady());
+
+        auto resumer = lines::Spawn([&] {
+            lines::Yield();
+            suspended.resume();
+        });
+
+        REQUIRE(future.get() == 7);
+        REQUIRE_FALSE(future.IsValid());
+        resumer.join();
+    });
+}
+
+TEST_CASE("DroppedFutureDetachesTask") {
+    lines::SchedulerRun([] {
+        std::coroutine_handle<> suspended;
+        auto value = std::make_shared<int>(42);
+        auto coro = [&](std::shared_ptr<int> value) -> coro::AsyncTask<int> {
+            co_await ManualSuspend{&suspended};
+            co_return *value;
+        };
+
+        coro(value).Run();
+        REQUIRE(value.use_count() == 2);
+        suspended.resume();
+        REQUIRE(value.use_count() == 1);
+    });
+}
+
+TEST_CASE("VoidAndReferenceTasks") {
+    lines::SchedulerRun([] {
+        int value = 0;
+        auto set = [&](int new_value) -> coro::AsyncTask<void> {
+            value = new_value;
+            co_return;
+        };
+        auto ref = [&]() -> coro::AsyncTask<int&> {
+            co_await set(1);
+            co_return value;
+        };
+        auto fail = []() -> coro::AsyncTask<void> {
+            throw std::runtime_error("Oops");
+            co_return;
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<void> {
+            int& result = co_await ref();
+            REQUIRE(&result == &value);
+            REQUIRE(result == 1);
+            REQUIRE_THROWS_WITH(co_await fail(), "Oops");
+        };
+
+        coro().Run().get();
+        REQUIRE(&ref().Run().get() == &value);
+        REQUIRE_THROWS_WITH(fail().Run().get(), "Oops");
+    });
+}
+
+TEST_CASE("PromiseSize") {
+    // Frame size drives the memory footprint of suspended tasks,
+    // make every new promise member a deliberate decision.
+    using coro::detail::AsyncTaskPromise;
+    STATIC_REQUIRE(sizeof(AsyncTaskPromise<void>) == 4 * sizeof(void*));
+    STATIC_REQUIRE(sizeof(AsyncTaskPromise<int>) == 5 * sizeof(void*));
+    STATIC_REQUIRE(sizeof(AsyncTaskPromise<int&>) == 5 * sizeof(void*));
+    STATIC_REQUIRE(sizeof(AsyncTaskPromise<coro::Unit>) == 5 * sizeof(void*));
+    STATIC_REQUIRE(sizeof(AsyncTaskPromise<std::string>) ==
+                   3 * sizeof(void*) +
+                       sizeof(std::variant<std::monostate, std::string, std::exception_ptr>));
+}
+
+#ifdef CORO_FRAME_PROFILER
+
+TEST_CASE("FrameProfiler") {
+    constexpr size_t kIterCount = 10;
+
+    auto child = [](size_t value) -> coro::AsyncTask<size_t> {
+        co_return value;
+    };
+    auto coro = [&]() -> coro::AsyncTask<size_t> {
+        size_t sum = 0;
+        for (size_t i = 0; i < kIterCount; ++i) {
+            sum += co_await child(i);
+        }
+        co_return sum;
+    };
+    REQUIRE(coro().Run().get() == kIterCount * (kIterCount - 1) / 2);
+
+    auto profile = coro::GetFrameProfile();
+    auto awaited = std::find_if(profile.begin(), profile.end(), [](const auto& entry) {
+        return entry.elidable >= kIterCount;
+    });
+    REQUIRE(awaited != profile.end());
+    REQUIRE(awaited->live == 0);
+    REQUIRE(awaited->frame_size > 0);
+    // A lambda is not exported, it is named by its offset in the executable
+    REQUIRE_FALSE(awaited->function.starts_with("0x"));
+}
+
+#endif
+
+TEST_CASE("WhenAll") {
+    lines::SchedulerRun([] {
+        auto number = [](int value) -> coro::AsyncTask<int> {
+            co_return value;
+        };
+        auto nothing = []() -> coro::AsyncTask<void> {
+            co_return;
+        };
+        auto move_only = [](int value) -> coro::AsyncTask<MoveOnlyInt> {
+            co_return MoveOnlyInt(value);
+        };
+        auto fail = [](const char* message) -> coro::AsyncTask<int> {
+            throw std::runtime_error(message);
+            co_return 0;
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<int> {
+            auto [a, unit, b] = co_await coro::WhenAll(number(1), nothing(), move_only(2));
+            REQUIRE(unit == coro::Unit{});
+
+            std::vector<coro::AsyncTask<int>> tasks;
+            for (int i = 0; i < 100; ++i) {
+                tasks.push_back(number(i));
+            }
+            auto results = co_await coro::WhenAll(std::move(tasks));
+            REQUIRE(results.size() == 100);
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(results[i] == i);
+            }
+
+            REQUIRE((co_await coro::WhenAll(std::vector<coro::AsyncTask<int>>{})).empty());
+
+            // References come back wrapped, referring to the objects themselves
+            std::array<int, 3> values{1, 2, 3};
+            auto element = [&](size_t index) -> coro::AsyncTask<int&> {
+                co_return values[index];
+            };
+            std::vector<coro::AsyncTask<int&>> refs;
+            for (size_t i = 0; i < values.size(); ++i) {
+                refs.push_back(element(i));
+            }
+            auto elements = co_await coro::WhenAll(std::move(refs));
+            REQUIRE(elements.size() == values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                REQUIRE(&elements[i].get() == &values[i]);
+            }
+
+            REQUIRE_THROWS_WITH(co_await coro::WhenAll(number(1), fail("first"), fail("second")),
+                                "first");
+            REQUIRE_THROWS_AS(co_await coro::WhenAll(number(1), coro::AsyncTask<int>()),
+                              coro::AsyncTaskInvalid);
+
+            co_return a + *b.value;
+        };
+
+        REQUIRE(coro().Run().get() == 3);
+    });
+}
+
+TEST_CASE("WhenAllResumesAfterLastChild") {
+    lines::SchedulerRun([] {
+        constexpr int kTaskCount = 10;
+
+        std::array<std::coroutine_handle<>, kTaskCount> suspended{};
+        auto child = [&](int index) -> coro::AsyncTask<int> {
+            co_await ManualSuspend{&suspended[index]};
+            co_return index;
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<int> {
+            std::vector<coro::AsyncTask<int>> tasks;
+            for (int i = 0; i < kTaskCount; ++i) {
+                tasks.push_back(child(i));
+            }
+
+            int sum = 0;
+            for (auto result : co_await coro::WhenAll(std::move(tasks))) {
+                sum += result;
+            }
+            co_return sum;
+        };
+
+        auto future = coro().Run();
+        for (int i = kTaskCount - 1; i >= 0; --i) {
+            REQUIRE_FALSE(future.IsReady());
+            suspended[i].resume();
+        }
+        REQUIRE(future.IsReady());
+        REQUIRE(future.get() == kTaskCount * (kTaskCount - 1) / 2);
+    });
+}
+
+TEST_CASE("WhenAny") {
+    lines::SchedulerRun([] {
+        std::array<std::coroutine_handle<>, 3> suspended{};
+        auto child = [&](int index) -> coro::AsyncTask<int> {
+            co_await ManualSuspend{&suspended[index]};
+            co_return index * 10;
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<coro::WhenAnyResult<int>> {
+            co_return co_await coro::WhenAny(child(0), child(1), child(2));
+        };
+
+        auto future = coro().Run();
+        suspended[2].resume();
+        suspended[0].resume();
+        REQUIRE_FALSE(future.IsReady());
+        suspended[1].resume();
+
+        auto result = future.get();
+        REQUIRE(result.index == 2);
+        REQUIRE(result.value == 20);
+    });
+}
+
+TEST_CASE("ResultTasks") {
+    enum class Errc { kNotFound, kTimeout };
+
+    int resumed = 0;
+    auto leaf = [](int value) -> coro::AsyncTask<coro::Result<int, Errc>> {
+        if (value < 0) {
+            co_return coro::Err(Errc::kNotFound);
+        }
+        co_return value;
+    };
+    auto middle = [&](int value) -> coro::AsyncTask<coro::Result<int, Errc>> {
+        auto result = co_await coro::Try(leaf(value));
+        ++resumed;
+        co_return result * 2;
+    };
+    auto root = [&](int value) -> coro::AsyncTask<coro::Result<std::string, Errc>> {
+        auto result = co_await coro::Try(middle(value));
+        ++resumed;
+        co_return std::to_string(result);
+    };
+
+    REQUIRE(root(21).Run().get() == "42");
+    REQUIRE(resumed == 2);
+
+    auto failed = root(-1).Run().get();
+    REQUIRE(resumed == 2);
+    REQUIRE(failed.error() == Errc::kNotFound);
+
+    // Exceptions still propagate through Try
+    auto thrower = []() -> coro::AsyncTask<coro::Result<void, Errc>> {
+        throw std::runtime_error("boom");
+        co_return {};
+    };
+    auto caller = [&]() -> coro::AsyncTask<coro::Result<void, Errc>> {
+        co_await coro::Try(thrower());
+        co_return {};
+    };
+    REQUIRE_THROWS_WITH(caller().Run().get(), "boom");
+}
+
+TEST_CASE("ErrorPathBenchmark", "[.][benchmark]") {
+    constexpr int kDepth = 8;
+
+    std::function<coro::AsyncTask<int>(int)> throwing = [&](int depth) -> coro::AsyncTask<int> {
+        if (depth == 0) {
+            throw std::runtime_error("failed");
+        }
+        co_return co_await throwing(depth - 1) + 1;
+    };
+    std::function<coro::AsyncTask<coro::Result<int, int>>(int)> returning =
+        [&](int depth) -> coro::AsyncTask<coro::Result<int, int>> {
+        if (depth == 0) {
+            co_return coro::Err(-1);
+        }
+        co_return co_await coro::Try(returning(depth - 1)) + 1;
+    };
+
+    BENCHMARK("Exception") {
+        try {
+            return throwing(kDepth).Run().get();
+        } catch (const std::runtime_error&) {
+            return -1;
+        }
+    };
+
+    BENCHMARK("Result") {
+        auto result = returning(kDepth).Run().get();
+        return result ? *result : result.error();
+    };
+}
+
+TEST_CASE("CoroutinesOnScheduler") {
+    lines::SchedulerRun([] {
+        constexpr int kTaskCount = 1'000;
+
+        int finished = 0;
+        auto coro = [&](int index) -> coro::AsyncTask<int> {
+            for (int i = 0; i < 3; ++i) {
+                co_await lines::YieldAwaitable{};
+            }
+            co_await lines::SleepForAsync(1ms);
+            ++finished;
+            co_return index;
+        };
+
+        std::vector<coro::Future<int>> futures;
+        for (int i = 0; i < kTaskCount; ++i) {
+            futures.push_back(coro(i).Run());
+        }
+#ifndef LINES_THREADS
+        REQUIRE(finished == 0);
+#endif
+
+        int sum = 0;
+        for (auto& future : futures) {
+            sum += future.get();
+        }
+        REQUIRE(finished == kTaskCount);
+        REQUIRE(sum == kTaskCount * (kTaskCount - 1) / 2);
+    });
+}
+
+struct CopyCounter {
+    explicit CopyCounter(int value, int* copies) : value(value), copies(copies) {
+    }
+
+    CopyCounter(const CopyCounter& other) : value(other.value), copies(other.copies) {
+        ++*copies;
+    }
+
+    CopyCounter& operator=(const CopyCounter& other) {
+        value = other.value;
+        copies = other.copies;
+        ++*copies;
+        return *this;
+    }
+
+    int value;
+    int* copies;
+};
+
+TEST_CASE("Generator") {
+    int copies = 0;
+    auto numbers = [&](int count) -> coro::Generator<const CopyCounter> {
+        CopyCounter current(0, &copies);
+        for (int i = 0; i < count; ++i) {
+            current.value = i;
+            co_yield current;
+        }
+        co_yield CopyCounter(count, &copies);
+    };
+
+    int sum = 0;
+    for (const auto& number : numbers(100)) {
+        sum += number.value;
+    }
+    REQUIRE(sum == 100 * 101 / 2);
+    REQUIRE(copies == 0);
+
+    auto fail = []() -> coro::Generator<int> {
+        co_yield 1;
+        throw std::runtime_error("Oops");
+    };
+    auto generator = fail();
+    auto it = generator.begin();
+    REQUIRE(*it == 1);
+    REQUIRE_THROWS_WITH(++it, "Oops");
+    REQUIRE(it == generator.end());
+}
+
+TEST_CASE("AsyncGenerator") {
+    lines::SchedulerRun([] {
+        int copies = 0;
+        auto next_number = [](int value) -> coro::AsyncTask<int> {
+            co_await lines::YieldAwaitable{};
+            co_return value;
+        };
+        auto numbers = [&](int count) -> coro::AsyncGenerator<CopyCounter> {
+            CopyCounter current(0, &copies);
+            for (int i = 0; i < count; ++i) {
+                current.value = co_await next_number(i);
+                co_yield current;
+            }
+            throw std::runtime_error("Oops");
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<int> {
+            auto generator = numbers(100);
+            int sum = 0;
+            for (int i = 0; i < 100; ++i) {
+                auto number = co_await generator.Next();
+                REQUIRE(number);
+                REQUIRE(number->value == i);
+                sum += number->value;
+            }
+            REQUIRE_THROWS_WITH(co_await generator.Next(), "Oops");
+            REQUIRE(co_await generator.Next() == nullptr);
+            co_return sum;
+        };
+
+        REQUIRE(coro().Run().get() == 99 * 100 / 2);
+        REQUIRE(copies == 0);
+    });
+}
+
+#ifndef LINES_THREADS
+
+TEST_CASE("AsyncMutex") {
+    lines::SchedulerRun([] {
+        constexpr int kTaskCount = 100;
+        constexpr int kIterCount = 10;
+
+        lines::AsyncMutex mutex;
+        bool locked = false;
+        int counter = 0;
+
+        auto coro = [&](bool handoff) -> coro::AsyncTask<void> {
+            for (int i = 0; i < kIterCount; ++i) {
+                co_await mutex.Lock();
+                REQUIRE_FALSE(locked);
+                locked = true;
+                co_await lines::YieldAwaitable{};
+                ++counter;
+                locked = false;
+                if (handoff) {
+                    co_await mutex.UnlockAndSwitch();
+                } else {
+                    mutex.Unlock();
+                }
+            }
+        };
+
+        std::vector<coro::Future<void>> futures;
+        for (int i = 0; i < kTaskCount; ++i) {
+            futures.push_back(coro(i % 2 == 0).Run());
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+        REQUIRE(counter == kTaskCount * kIterCount);
+        REQUIRE(mutex.TryLock());
+        mutex.Unlock();
+    });
+}
+
+TEST_CASE("AsyncCondvar") {
+    lines::SchedulerRun([] {
+        constexpr int kConsumerCount = 10;
+
+        lines::AsyncMutex mutex;
+        lines::AsyncCondvar condvar;
+        std::vector<int> queue;
+        bool closed = false;
+
+        auto consumer = [&]() -> coro::AsyncTask<int> {
+            int sum = 0;
+            co_await mutex.Lock();
+            while (true) {
+                while (queue.empty() && !closed) {
+                    co_await condvar.Wait(mutex);
+                }
+                if (queue.empty()) {
+                    break;
+                }
+                sum += queue.back();
+                queue.pop_back();
+            }
+            mutex.Unlock();
+            co_return sum;
+        };
+
+        auto producer = [&]() -> coro::AsyncTask<void> {
+            for (int i = 1; i <= 100; ++i) {
+                co_await mutex.Lock();
+                queue.push_back(i);
+                condvar.NotifyOne();
+                mutex.Unlock();
+                co_await lines::YieldAwaitable{};
+            }
+            co_await mutex.Lock();
+            closed = true;
+            condvar.NotifyAll();
+            mutex.Unlock();
+        };
+
+        std::vector<coro::Future<int>> consumers;
+        for (int i = 0; i < kConsumerCount; ++i) {
+            consumers.push_back(consumer().Run());
+        }
+        producer().Run().get();
+
+        int sum = 0;
+        for (auto& future : consumers) {
+            sum += future.get();
+        }
+        REQUIRE(sum == 5050);
+    });
+}
+
+TEST_CASE("AsyncSemaphore") {
+    lines::SchedulerRun([] {
+        constexpr size_t kPermits = 3;
+
+        lines::AsyncSemaphore semaphore(kPermits);
+        size_t active = 0;
+        size_t max_active = 0;
+
+        auto coro = [&]() -> coro::AsyncTask<void> {
+            co_await semaphore.Acquire();
+            max_active = std::max(max_active, ++active);
+            co_await lines::YieldAwaitable{};
+            --active;
+            semaphore.Release();
+        };
+
+        std::vector<coro::Future<void>> futures;
+        for (int i = 0; i < 20; ++i) {
+            futures.push_back(coro().Run());
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+        REQUIRE(max_active == kPermits);
+        REQUIRE(semaphore.Available() == kPermits);
+    });
+}
+
+TEST_CASE("Cancellation") {
+    lines::SchedulerRun([] {
+        constexpr int kDepth = 10;
+
+        int unwound = 0;
+        std::function<coro::AsyncTask<int>(int)> coro = [&](int depth) -> coro::AsyncTask<int> {
+            lines::Defer count([&] { ++unwound; });
+            if (depth == 0) {
+                co_await lines::SleepForAsync(1h);
+                co_return 0;
+            }
+            co_return co_await coro(depth - 1) + 1;
+        };
+
+        coro::CancellationSource source;
+        auto future = coro::WithCancellation(coro(kDepth), source.GetToken()).Run();
+        REQUIRE_FALSE(future.IsReady());
+
+        auto start = std::chrono::steady_clock::now();
+        source.RequestCancellation();
+        REQUIRE_THROWS_AS(future.get(), coro::OperationCancelled);
+        REQUIRE(std::chrono::steady_clock::now() - start < 1s);
+        REQUIRE(unwound == kDepth + 1);
+
+        // Tasks started with a cancelled token do not run past their first await
+        auto cancelled = coro::WithCancellation(coro(kDepth), source.GetToken()).Run();
+        REQUIRE_THROWS_AS(cancelled.get(), coro::OperationCancelled);
+    });
+}
+
+TEST_CASE("CancellationFromOtherThreads") {
+    lines::SchedulerRun([] {
+        auto sleep = []() -> coro::AsyncTask<void> {
+            co_await lines::SleepForAsync(1h);
+        };
+
+        // The sleep is woken up on its own scheduler
+        coro::CancellationSource source;
+        auto future = coro::WithCancellation(sleep(), source.GetToken()).Run();
+        std::thread canceller([&] { source.RequestCancellation(); });
+        REQUIRE_THROWS_AS(future.get(), coro::OperationCancelled);
+        canceller.join();
+
+        // Cancelled between the check of the token and the registration:
+        // the awaitable is not suspended on, nothing would resume it
+        struct CancelsOnCheck {
+            coro::CancellationSource& source;
+
+            bool await_ready() {
+                source.RequestCancellation();
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<>) {
+            }
+            void await_resume() {
+            }
+            bool Cancel() {
+                return false;
+            }
+        };
+
+        coro::CancellationSource late;
+        auto park = [&]() -> coro::AsyncTask<void> {
+            co_await CancelsOnCheck{late};
+        };
+        auto parked = coro::WithCancellation(park(), late.GetToken()).Run();
+        REQUIRE_THROWS_AS(parked.get(), coro::OperationCancelled);
+    });
+}
+
+TEST_CASE("CancelledWaits") {
+    lines::SchedulerRun([] {
+        lines::AsyncMutex mutex;
+        lines::AsyncSemaphore semaphore(0);
+        lines::AsyncCondvar condvar;
+
+        auto lock = [&]() -> coro::AsyncTask<void> {
+            co_await mutex.Lock();
+            mutex.Unlock();
+        };
+        auto acquire = [&]() -> coro::AsyncTask<void> {
+            co_await semaphore.Acquire();
+        };
+        auto wait = [&]() -> coro::AsyncTask<bool> {
+            co_await mutex.Lock();
+            lines::Defer unlock([&] { mutex.Unlock(); });
+            co_await condvar.Wait(mutex);
+            co_return true;
+        };
+
+        coro::CancellationSource source;
+        auto waiting = coro::WithCancellation(wait(), source.GetToken()).Run();
+        REQUIRE(mutex.TryLock());
+        auto locking = coro::WithCancellation(lock(), source.GetToken()).Run();
+        auto acquiring = coro::WithCancellation(acquire(), source.GetToken()).Run();
+
+        source.RequestCancellation();
+        REQUIRE_THROWS_AS(locking.get(), coro::OperationCancelled);
+        REQUIRE_THROWS_AS(acquiring.get(), coro::OperationCancelled);
+
+        // The condvar waiter throws once it owns the mutex again
+        mutex.Unlock();
+        REQUIRE_THROWS_AS(waiting.get(), coro::OperationCancelled);
+        REQUIRE(mutex.TryLock());
+        mutex.Unlock();
+        REQUIRE(semaphore.Available() == 0);
+    });
+}
+
+TEST_CASE("WhenAnyCancelsLosers") {
+    lines::SchedulerRun([] {
+        int cancelled = 0;
+        auto child = [&](std::chrono::milliseconds delay) -> coro::AsyncTask<int> {
+            try {
+                co_await lines::SleepForAsync(delay);
+            } catch (const coro::OperationCancelled&) {
+                ++cancelled;
+                throw;
+            }
+            co_return static_cast<int>(delay.count());
+        };
+
+        auto coro = [&]() -> coro::AsyncTask<coro::WhenAnyResult<int>> {
+            co_return co_await coro::WhenAny(child(1h), child(1ms), child(1h));
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        auto result = coro().Run().get();
+        REQUIRE(std::chrono::steady_clock::now() - start < 1s);
+        REQUIRE(result.index == 1);
+        REQUIRE(result.value == 1);
+        REQUIRE(cancelled == 2);
+    });
+}
+
+TEST_CASE("RunPolicies") {
+    auto run_order = [](lines::RunPolicy policy) {
+        std::vector<int> order;
+        lines::Scheduler::This().SetRunPolicy(policy);
+        lines::SchedulerRun(
+            [&] {
+                std::vector<lines::Handle> handles;
+                for (int i = 0; i < 3; ++i) {
+                    handles.push_back(lines::Spawn([&order, i] { order.push_back(i); }));
+                }
+                for (auto& handle : handles) {
+                    handle.join();
+                }
+            },
+            1);
+        lines::Scheduler::This().SetRunPolicy(lines::RunPolicy::Random);
+        return order;
+    };
+
+    REQUIRE(run_order(lines::RunPolicy::Fifo) == std::vector{0, 1, 2});
+    // The last spawned fiber takes the run-next slot
+    REQUIRE(run_order(lines::RunPolicy::Lifo) == std::vector{2, 0, 1});
+
+    auto random = run_order(lines::RunPolicy::Random);
+    std::sort(random.begin(), random.end());
+    REQUIRE(random == std::vector{0, 1, 2});
+}
+
+namespace {
+
+// Stacks grow down: the first byte of a frame is its deepest. The store is
+// volatile, or the whole frame may be optimized away.
+void DirtyFrame(std::span<std::byte> frame) {
+    static_cast<volatile std::byte&>(frame.front()) = std::byte{1};
+}
+
+// Touches every page down to `bytes` below the caller, as a call chain does.
+[[gnu::noinline]] void DirtyStack(size_t bytes) {
+    std::array<std::byte, 512> frame;
+    DirtyFrame(frame);
+    if (bytes > frame.size()) {
+        DirtyStack(bytes - frame.size());
+    }
+    DirtyFrame(frame);
+}
+
+}  // namespace
+
+TEST_CASE("StackPool") {
+    auto& pool = lines::Scheduler::This().GetStackPool();
+    auto limit = pool.GetLimit();
+    pool.SetLimit(4);
+
+    std::vector<std::byte*> stacks;
+    lines::SchedulerRun([&] {
+        for (int i = 0; i < 3; ++i) {
+            lines::Spawn([&] {
+                // Dirty a page far below the hot top of the stack
+                std::array<std::byte, 256 * 1024> frame;
+                DirtyFrame(frame);
+                stacks.push_back(frame.data());
+            }).join();
+        }
+    });
+
+    // A fiber at a time needs a single stack, reused by every spawn
+    REQUIRE(std::ranges::all_of(stacks, [&](auto stack) { return stack == stacks.front(); }));
+    REQUIRE(pool.Size() >= 1);
+    REQUIRE(pool.Size() <= 4);
+
+    pool.SetLimit(0);
+    REQUIRE(pool.Size() == 0);
+    pool.SetLimit(limit);
+
+    // Only a stack touched below its hot top is given back, released pages
+    // read as zeroes
+    constexpr size_t kHot = 64 * 1024;
+    lines::Stack stack(1 << 20);
+    auto view = stack.GetStackView();
+    stack.ReleaseTouchedMemory(kHot);
+
+    std::ranges::fill(view.first(view.size() - kHot), std::byte{1});
+    stack.ReleaseTouchedMemory(kHot);
+    REQUIRE(view.front() == std::byte{0});
+
+    // A deep page the fiber jumped to, over the watermark, waits for a sweep
+    view.front() = std::byte{1};
+    stack.ReleaseTouchedMemory(kHot);
+    REQUIRE(view.front() == std::byte{1});
+    for (int i = 0; i < 16; ++i) {
+        stack.ReleaseTouchedMemory(kHot);
+    }
+    REQUIRE(view.front() == std::byte{0});
+}
+
+TEST_CASE("StackSizes") {
+    REQUIRE(lines::StackPool::ClassSize(0) == lines::Stack::GetDefaultSize());
+    REQUIRE(lines::StackPool::ClassSize(16 * 1024) == 16 * 1024);
+    REQUIRE(lines::StackPool::ClassSize(20 * 1024) == 32 * 1024);
+
+    lines::SchedulerRun(
+        [] {
+            // A deep frame fits in a big stack
+            lines::Spawn(lines::SpawnOptions{.stack_size = 64 << 20}, [] {
+                std::array<std::byte, 16 << 20> frame;
+                DirtyFrame(frame);
+            }).join();
+
+            int leaves = 0;
+            lines::SpawnMany(lines::SpawnOptions{.stack_size = 16 * 1024}, 100, [&](size_t) {
+                std::array<std::byte, 4 * 1024> frame;
+                DirtyFrame(frame);
+                ++leaves;
+            }).JoinAll();
+            REQUIRE(leaves == 100);
+
+            // The requested size is left to the routine: the control block
+            // and the fiber local storage come on top of it
+            lines::Spawn(lines::SpawnOptions{.stack_size = 16 * 1024}, [] {
+                DirtyStack(14 * 1024);
+            }).join();
+        },
+        1);
+
+    auto size = lines::Stack::GetDefaultSize();
+    lines::SetDefaultStackSize(1 << 20);
+    REQUIRE(lines::Stack().GetSize() == 1 << 20);
+    lines::SetDefaultStackSize(size);
+}
+
+TEST_CASE("FiberControlBlock") {
+    lines::SchedulerRun(
+        [] {
+            // The fiber lives at the top of its own stack
+            lines::Spawn([] {
+                int local = 0;
+                auto fiber = reinterpret_cast<std::byte*>(lines::Fiber::This());
+                auto frame = reinterpret_cast<std::byte*>(&local);
+                REQUIRE(frame < fiber);
+                REQUIRE(fiber - frame < 64 * 1024);
+            }).join();
+
+            // Every fiber on a reused stack starts with empty local storage
+            for (int i = 0; i < 1000; ++i) {
+                lines::Spawn([i] {
+                    int value = i;
+                    lines::ThreadLocalPtr<int> first(&value);
+                    lines::ThreadLocalPtr<int> second(nullptr);
+                    REQUIRE(*first == i);
+                    REQUIRE(!second);
+                }).join();
+            }
+        },
+        1);
+}
+
+TEST_CASE("StackProfiler") {
+    lines::ResetStackProfile();
+    lines::EnableStackProfiler();
+
+    lines::SchedulerRun(
+        [] {
+            auto deep = [] {
+                std::array<std::byte, 256 * 1024> frame;
+                DirtyFrame(frame);
+            };
+            auto shallow = [] {};
+            for (int i = 0; i < 3; ++i) {
+                lines::Spawn(deep).join();
+                lines::Spawn(shallow).join();
+            }
+        },
+        1);
+    lines::EnableStackProfiler(false);
+
+    // The root, the deep and the shallow fibers
+    auto profile = lines::GetStackProfile();
+    REQUIRE(profile.size() == 3);
+    REQUIRE(profile.front().fibers == 3);
+    REQUIRE(profile.front().max_depth >= 256 * 1024);
+    REQUIRE(profile.front().max_depth < 512 * 1024);
+    REQUIRE(profile.front().depths[lines::detail::StackDepthBucket(profile.front().max_depth)] == 3);
+    REQUIRE(profile.back().max_depth < 64 * 1024);
+    // Named by the line of the spawn, not the type of the routine
+    REQUIRE(profile.front().site.find("test.cpp:") != std::string::npos);
+
+    std::ostringstream dump;
+    lines::DumpStackProfile(dump);
+    REQUIRE(dump.str().find("3 fibers") != std::string::npos);
+    lines::ResetStackProfile();
+}
+
+TEST_CASE("SpawnJoinBenchmark", "[.][benchmark]") {
+    auto& pool = lines::Scheduler::This().GetStackPool();
+    auto limit = pool.GetLimit();
+
+    auto spawn_join = [](size_t depth = 0) {
+        lines::SchedulerRun(
+            [depth] {
+                for (int i = 0; i < 1000; ++i) {
+                    lines::Spawn([depth] { DirtyStack(depth); }).join();
+                }
+            },
+            1);
+    };
+
+    pool.SetLimit(0);
+    BENCHMARK("1000 x Spawn + join, no pool") {
+        spawn_join();
+    };
+
+    pool.SetLimit(limit);
+    BENCHMARK("1000 x Spawn + join, pooled") {
+        spawn_join();
+    };
+
+    // Below the hot top of the stack, every release is an madvise
+    BENCHMARK("1000 x Spawn + join, pooled, 256 KiB deep") {
+        spawn_join(256 * 1024);
+    };
+}
+
+TEST_CASE("SpawnMany") {
+    SECTION("RunsEveryIndex") {
+        std::vector<int> runs(1000);
+        lines::SchedulerRun([&] {
+            std::fill(runs.begin(), runs.end(), 0);
+            auto group = lines::SpawnMany(runs.size(), [&](size_t index) {
+                lines::Yield();
+                ++runs[index];
+            });
+            REQUIRE(group.Size() == runs.size());
+            group.JoinAll();
+            REQUIRE(std::ranges::count(runs, 1) == 1000);
+        });
+    }
+
+    SECTION("SameOrderAsSpawn") {
+        auto run_order = [](lines::RunPolicy policy) {
+            std::vector<size_t> order;
+            lines::Scheduler::This().SetRunPolicy(policy);
+            lines::SchedulerRun(
+                [&] {
+                    lines::SpawnMany(3, [&](size_t index) { order.push_back(index); }).JoinAll();
+                },
+                1);
+            lines::Scheduler::This().SetRunPolicy(lines::RunPolicy::Random);
+            return order;
+        };
+
+        REQUIRE(run_order(lines::RunPolicy::Fifo) == std::vector<size_t>{0, 1, 2});
+        REQUIRE(run_order(lines::RunPolicy::Lifo) == std::vector<size_t>{2, 0, 1});
+    }
+
+    SECTION("Pool") {
+        lines::SchedulerPool pool(4);
+        std::atomic<int> counter = 0;
+        pool.Run([&] {
+            lines::SpawnMany(1000, [&](size_t) {
+                lines::Yield();
+                counter.fetch_add(1);
+            }).JoinAll();
+        });
+        REQUIRE(counter.load() == 1000);
+    }
+}
+
+TEST_CASE("SpawnManyBenchmark", "[.][benchmark]") {
+    constexpr size_t kFibers = 10'000;
+
+    BENCHMARK("Spawn x 10000") {
+        lines::SchedulerRun(
+            [&] {
+                std::vector<lines::Handle> handles;
+                handles.reserve(kFibers);
+                for (size_t i = 0; i < kFibers; ++i) {
+                    handles.push_back(lines::Spawn([] {}));
+                }
+                for (auto& handle : handles) {
+                    handle.join();
+                }
+            },
+            1);
+    };
+
+    BENCHMARK("SpawnMany(10000)") {
+        lines::SchedulerRun([&] { lines::SpawnMany(kFibers, [](size_t) {}).JoinAll(); }, 1);
+    };
+}
+
+TEST_CASE("FiberGroups") {
+    auto spin = [](std::chrono::microseconds duration) {
+        auto deadline = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < deadline) {
+        }
+    };
+
+    lines::FiberGroup batch(lines::FiberGroup::kDefaultWeight);
+    lines::FiberGroup latency(3 * lines::FiberGroup::kDefaultWeight);
+    int batch_slices = 0;
+    int latency_slices = 0;
+    lines::SchedulerRun(
+        [&] {
+            bool stop = false;
+            auto worker = [&](int* slices) {
+                while (!stop) {
+                    spin(100us);
+                    ++*slices;
+                    stop = batch_slices + latency_slices >= 400;
+                    lines::Yield();
+                }
+            };
+
+            std::vector<lines::Handle> handles;
+            // Many batch fibers still get a quarter of the time between them
+            for (int i = 0; i < 10; ++i) {
+                handles.push_back(lines::Spawn(batch, [&] { worker(&batch_slices); }));
+            }
+            handles.push_back(lines::Spawn(latency, [&] { worker(&latency_slices); }));
+            for (auto& handle : handles) {
+                handle.join();
+            }
+        },
+        1);
+
+    double ratio = static_cast<double>(latency_slices) / batch_slices;
+    REQUIRE(ratio > 2);
+    REQUIRE(ratio < 4.5);
+    REQUIRE(latency.GetRuntime() > batch.GetRuntime());
+}
+
+TEST_CASE("IdleSchedulerSleeps") {
+    auto& scheduler = lines::Scheduler::This();
+    auto idle = scheduler.GetIdleTime();
+
+    lines::CpuClock cpu;
+    cpu.Start();
+    lines::SchedulerRun([] { lines::SleepFor(50ms); }, 1);
+
+    // The thread blocks until the deadline instead of polling the clock
+    REQUIRE(scheduler.GetIdleTime() - idle >= 40ms);
+    REQUIRE(cpu.Finish() < 25);
+}
+
+TEST_CASE("SchedulerStats") {
+    auto& scheduler = lines::Scheduler::This();
+    auto before = scheduler.GetStats();
+
+    std::chrono::nanoseconds runtime{};
+    std::chrono::nanoseconds max_slice{};
+    lines::SchedulerRun(
+        [&] {
+            auto sleeper = lines::Spawn([] { lines::SleepFor(1ms); });
+            for (int i = 0; i < 3; ++i) {
+                lines::Yield();
+            }
+            sleeper.join();
+            runtime = lines::Fiber::This()->GetRuntime();
+            max_slice = lines::Fiber::This()->GetMaxSlice();
+        },
+        1);
+
+    auto after = scheduler.GetStats();
+    REQUIRE(after.spawns - before.spawns == 2);
+    REQUIRE(after.deaths - before.deaths == 2);
+    REQUIRE(after.yields - before.yields == 3);
+    REQUIRE(after.timer_fires - before.timer_fires == 1);
+    // The root and the sleeper start and resume once each at least: a yield
+    // may pick the yielder again, and with the sleeper parked returns at once
+    REQUIRE(after.switches - before.switches >= 4);
+    REQUIRE(after.direct_switches <= after.switches);
+    REQUIRE(after.suspends - before.suspends >= 2);
+    REQUIRE(runtime > 0ns);
+    REQUIRE(max_slice <= runtime);
+
+    uint64_t suspends = 0;
+    uint64_t timer_suspends = 0;
+    for (const auto& [type, count] : after.suspends_by_type) {
+        suspends += count;
+        timer_suspends += type == "lines::Timer" ? count : 0;
+    }
+    REQUIRE(suspends == after.suspends);
+    REQUIRE(timer_suspends >= 1);
+
+    uint64_t picks = 0;
+    for (auto count : after.run_queue_lengths) {
+        picks += count;
+    }
+    REQUIRE(picks == after.switches);
+
+    std::ostringstream dump;
+    dump << after;
+    REQUIRE(dump.str().find("suspends on lines::Timer") != std::string::npos);
+}
+
+TEST_CASE("DirectSwitches") {
+    auto& scheduler = lines::Scheduler::This();
+
+    SECTION("LonelyYield") {
+        auto before = scheduler.GetStats();
+        lines::SchedulerRun(
+            [] {
+                for (int i = 0; i < 100; ++i) {
+                    lines::Yield();
+                }
+            },
+            1);
+
+        auto after = scheduler.GetStats();
+        REQUIRE(after.yields - before.yields == 100);
+        REQUIRE(after.switches - before.switches == 1);
+    }
+
+    SECTION("MutexHandoff") {
+        auto before = scheduler.GetStats();
+        lines::Mutex mutex;
+        int counter = 0;
+        lines::SchedulerRun(
+            [&] {
+                auto worker = [&] {
+                    for (int i = 0; i < 1000; ++i) {
+                        std::lock_guard guard(mutex);
+                        ++counter;
+                        lines::Yield();
+                    }
+                };
+                auto first = lines::Spawn(worker);
+                auto second = lines::Spawn(worker);
+                first.join();
+                second.join();
+            },
+            1);
+        REQUIRE(counter == 2000);
+
+        // Most switches skip the scheduler, which still gets a turn now and then
+        auto after = scheduler.GetStats();
+        auto switches = after.switches - before.switches;
+        auto direct = after.direct_switches - before.direct_switches;
+        REQUIRE(direct > switches / 2);
+        REQUIRE(direct < switches);
+    }
+
+    SECTION("YieldingWaitsForTimers") {
+        bool woken = false;
+        lines::SchedulerRun(
+            [&] {
+                lines::Spawn([&] {
+                    lines::SleepFor(1ms);
+                    woken = true;
+                }).detach();
+                while (!woken) {
+                    lines::Yield();
+                }
+            },
+            1);
+        REQUIRE(woken);
+    }
+}
+
+TEST_CASE("PingPongBenchmark", "[.][benchmark]") {
+    BENCHMARK("2 x 10000 Yield") {
+        lines::SchedulerRun(
+            [] {
+                auto worker = [] {
+                    for (int i = 0; i < 10000; ++i) {
+                        lines::Yield();
+                    }
+                };
+                auto first = lines::Spawn(worker);
+                auto second = lines::Spawn(worker);
+                first.join();
+                second.join();
+            },
+            1);
+    };
+
+    BENCHMARK("10000 x WaitQueue round trip") {
+        lines::SchedulerRun(
+            [] {
+                lines::WaitQueue ping;
+                lines::WaitQueue pong;
+                int turn = 0;
+                auto wait = [](lines::WaitQueue& queue, int& turn, int expected) {
+                    while (true) {
+                        auto epoch = queue.Epoch();
+                        if (turn == expected) {
+                            break;
+                        }
+                        queue.Wait(epoch);
+                    }
+                };
+
+                auto echo = lines::Spawn([&] {
+                    for (int i = 0; i < 10000; ++i) {
+                        wait(ping, turn, 1);
+                        turn = 0;
+                        pong.WakeOne();
+                    }
+                });
+                for (int i = 0; i < 10000; ++i) {
+                    turn = 1;
+                    ping.WakeOne();
+                    wait(pong, turn, 0);
+                }
+                echo.join();
+            },
+            1);
+    };
+}
+
+TEST_CASE("EmbeddedScheduler") {
+    auto& scheduler = lines::Scheduler::This();
+
+    SECTION("Steps") {
+        int steps = 0;
+        lines::Spawn([&] {
+            for (int i = 0; i < 3; ++i) {
+                ++steps;
+                lines::Yield();
+            }
+        }).detach();
+
+        auto next = scheduler.RunOnce();
+        REQUIRE(steps == 1);
+        REQUIRE(next);
+        REQUIRE(*next <= lines::Now());
+
+        REQUIRE(!scheduler.RunUntilIdle());
+        REQUIRE(steps == 3);
+    }
+
+    SECTION("ReturnsNextDeadline") {
+        bool woke = false;
+        lines::Spawn([&] {
+            lines::SleepFor(50ms);
+            woke = true;
+        }).detach();
+
+        auto next = scheduler.RunUntilIdle();
+        REQUIRE(next);
+        REQUIRE(*next > lines::Now());
+
+        // Waits for the timer no longer than the budget
+        auto start = lines::Now();
+        REQUIRE(scheduler.RunFor(5ms) == next);
+        REQUIRE(!woke);
+        REQUIRE(lines::Now() - start < 40ms);
+
+        REQUIRE(!scheduler.RunFor(1s));
+        REQUIRE(woke);
+        REQUIRE(lines::Now() - start < 500ms);
+    }
+
+    SECTION("ParkedFibersAreNotDeadlock") {
+        lines::WaitQueue queue;
+        bool woke = false;
+        lines::Spawn([&] {
+            queue.Wait(queue.Epoch());
+            woke = true;
+        }).detach();
+
+        REQUIRE(!scheduler.RunUntilIdle());
+        REQUIRE(!scheduler.RunFor(10ms));
+        REQUIRE(!woke);
+
+        queue.WakeAll();
+        scheduler.RunUntilIdle();
+        REQUIRE(woke);
+    }
+}
+
+TEST_CASE("SchedulerInbox") {
+    SECTION("WakesFiber") {
+        lines::SchedulerRun(
+            [] {
+                auto& scheduler = lines::Scheduler::This();
+                lines::WaitQueue queue;
+                bool done = false;
+
+                // Without the hold Run() would return while the fiber waits
+                scheduler.Hold();
+                std::thread thread([&] {
+                    std::this_thread::sleep_for(10ms);
+                    scheduler.Submit([&] {
+                        done = true;
+                        queue.WakeAll();
+                    });
+                    scheduler.Release();
+                });
+
+                auto epoch = queue.Epoch();
+                while (!done) {
+                    queue.Wait(epoch);
+                    epoch = queue.Epoch();
+                }
+                thread.join();
+            },
+            1);
+    }
+
+    SECTION("KeepsOrder") {
+        constexpr int kThreads = 4;
+        constexpr int kRoutines = 1000;
+
+        auto& scheduler = lines::Scheduler::This();
+        std::vector<int> last(kThreads, -1);
+        int count = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            scheduler.Hold();
+            threads.emplace_back([&, i] {
+                for (int j = 0; j < kRoutines; ++j) {
+                    scheduler.Submit([&, i, j] {
+                        REQUIRE(last[i] == j - 1);
+                        last[i] = j;
+                        ++count;
+                    });
+                }
+                scheduler.Release();
+            });
+        }
+
+        lines::detail::Run();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(count == kThreads * kRoutines);
+    }
+}
+
+TEST_CASE("SchedulerPool") {
+    lines::SchedulerPool pool(4);
+    REQUIRE(pool.NumWorkers() == 4);
+
+    SECTION("Mutex") {
+        lines::Mutex mutex;
+        int counter = 0;
+        pool.Run([&] {
+            std::vector<lines::Handle> handles;
+            for (int i = 0; i < 100; ++i) {
+                handles.push_back(lines::Spawn([&] {
+                    for (int j = 0; j < 100; ++j) {
+                        std::lock_guard guard(mutex);
+                        ++counter;
+                        lines::Yield();
+                    }
+                }));
+            }
+            for (auto& handle : handles) {
+                handle.join();
+            }
+        });
+        REQUIRE(counter == 100 * 100);
+    }
+
+    SECTION("Condvar") {
+        lines::Mutex mutex;
+        lines::Condvar condvar;
+        int turn = 0;
+        pool.Run([&] {
+            auto player = [&](int self) {
+                for (int i = 0; i < 1000; ++i) {
+                    std::unique_lock lock(mutex);
+                    while (turn % 2 != self) {
+                        condvar.Wait(lock);
+                    }
+                    ++turn;
+                    condvar.NotifyAll();
+                }
+            };
+            auto ping = lines::Spawn([&] { player(0); });
+            auto pong = lines::Spawn([&] { player(1); });
+            ping.join();
+            pong.join();
+        });
+        REQUIRE(turn == 2000);
+    }
+
+    SECTION("DetachedFibers") {
+        std::atomic<int> finished = 0;
+        pool.Run([&] {
+            for (int i = 0; i < 1000; ++i) {
+                lines::Spawn([&] {
+                    lines::Yield();
+                    ++finished;
+                }).detach();
+            }
+        });
+        // Run returns once every fiber has finished
+        REQUIRE(finished == 1000);
+    }
+}
+
+namespace {
+
+// Listening loopback socket on an ephemeral port.
+int ListenLoopback(sockaddr_in* address) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    *address = {};
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(*address);
+    REQUIRE(bind(fd, reinterpret_cast<sockaddr*>(address), length) == 0);
+    REQUIRE(listen(fd, 128) == 0);
+    REQUIRE(getsockname(fd, reinterpret_cast<sockaddr*>(address), &length) == 0);
+    return fd;
+}
+
+int ConnectLoopback(const sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    auto result =
+        lines::io::Connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    REQUIRE(result == 0);
+    return fd;
+}
+
+// Echoes until the peer closes the connection.
+void Echo(int fd) {
+    char buffer[4096];
+    while (true) {
+        auto size = lines::io::Read(fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            break;
+        }
+        for (ssize_t written = 0; written < size;) {
+            written += lines::io::Write(fd, buffer + written, size - written);
+        }
+    }
+    close(fd);
+}
+
+void EchoRoundTrips(const sockaddr_in& address, int count) {
+    int fd = ConnectLoopback(address);
+    std::string message(64, 'x');
+    std::string reply(message.size(), '\0');
+    for (int i = 0; i < count; ++i) {
+        REQUIRE(lines::io::Write(fd, message.data(), message.size()) == 64);
+        for (size_t read = 0; read < reply.size();) {
+            auto size = lines::io::Read(fd, reply.data() + read, reply.size() - read);
+            REQUIRE(size > 0);
+            read += size;
+        }
+        REQUIRE(reply == message);
+    }
+    close(fd);
+}
+
+}  // namespace
+
+TEST_CASE("ShardedScheduler") {
+    lines::ShardedScheduler shards(4, false);
+    REQUIRE(shards.NumCores() == 4);
+
+    SECTION("CallOn") {
+        shards.Run([&] {
+            REQUIRE(lines::ShardedScheduler::ThisCore() == 0);
+            for (size_t core = 0; core < shards.NumCores(); ++core) {
+                auto where = shards.CallOn(core, [] { return lines::ShardedScheduler::ThisCore(); });
+                REQUIRE(where == core);
+            }
+
+            shards.CallOn(1, [] {});
+            REQUIRE_THROWS_AS(shards.CallOn(2, [] { throw std::runtime_error("boom"); }),
+                              std::runtime_error);
+        });
+    }
+
+    SECTION("FibersStayOnTheirCore") {
+        std::atomic<int> finished = 0;
+        shards.Run([&] {
+            for (size_t core = 0; core < shards.NumCores(); ++core) {
+                shards.SubmitTo(core, [&, core] {
+                    std::vector<lines::Handle> handles;
+                    for (int i = 0; i < 10; ++i) {
+                        handles.push_back(lines::Spawn([&, core] {
+                            for (int j = 0; j < 100; ++j) {
+                                lines::Yield();
+                                REQUIRE(lines::ShardedScheduler::ThisCore() == core);
+                            }
+                            finished.fetch_add(1);
+                        }));
+                    }
+                    for (auto& handle : handles) {
+                        handle.join();
+                    }
+                });
+            }
+        });
+        REQUIRE(finished.load() == 40);
+    }
+
+    SECTION("RunsUntilSubmittedFibersFinish") {
+        std::atomic<int> finished = 0;
+        shards.Run([&] {
+            for (size_t core = 1; core < shards.NumCores(); ++core) {
+                shards.SubmitTo(core, [&] {
+                    lines::SleepFor(10ms);
+                    finished.fetch_add(1);
+                });
+            }
+        });
+        REQUIRE(finished.load() == 3);
+    }
+}
+
+TEST_CASE("MessagePassingBenchmark", "[.][benchmark]") {
+    constexpr size_t kCores = 4;
+    constexpr int kMessages = 10'000;
+
+    // Every message costs a little work on the receiving side
+    auto handle = [](int message) {
+        auto deadline = std::chrono::steady_clock::now() + 1us;
+        while (std::chrono::steady_clock::now() < deadline) {
+        }
+        return message + 1;
+    };
+
+    BENCHMARK("Scheduler") {
+        lines::SchedulerRun(
+            [&] {
+                std::vector<lines::Handle> senders;
+                for (size_t core = 0; core < kCores; ++core) {
+                    senders.push_back(lines::Spawn([&] {
+                        for (int i = 0; i < kMessages; ++i) {
+                            REQUIRE(handle(i) == i + 1);
+                            lines::Yield();
+                        }
+                    }));
+                }
+                for (auto& sender : senders) {
+                    sender.join();
+                }
+            },
+            1);
+    };
+
+    BENCHMARK("ShardedScheduler") {
+        lines::ShardedScheduler shards(kCores);
+        shards.Run([&] {
+            for (size_t core = 0; core < kCores; ++core) {
+                shards.SubmitTo(core, [&, core] {
+                    for (int i = 0; i < kMessages; ++i) {
+                        auto reply = shards.CallOn((core + 1) % kCores, [&, i] { return handle(i); });
+                        REQUIRE(reply == i + 1);
+                    }
+                });
+            }
+        });
+    };
+}
+
+TEST_CASE("FiberIo") {
+    SECTION("Pipe") {
+        int fds[2];
+        REQUIRE(pipe2(fds, O_NONBLOCK) == 0);
+
+        std::vector<std::string> events;
+        lines::SchedulerRun(
+            [&] {
+                auto reader = lines::Spawn([&] {
+                    char buffer[16];
+                    auto size = lines::io::Read(fds[0], buffer, sizeof(buffer));
+                    events.emplace_back(buffer, size);
+                });
+                lines::SleepFor(10ms);
+                events.push_back("write");
+                REQUIRE(lines::io::Write(fds[1], "hello", 5) == 5);
+                reader.join();
+            },
+            1);
+        REQUIRE(events == std::vector<std::string>{"write", "hello"});
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    SECTION("FullPipe") {
+        int fds[2];
+        REQUIRE(pipe2(fds, O_NONBLOCK) == 0);
+
+        // Larger than the pipe buffer, so the writer waits for the reader
+        constexpr size_t kSize = 1 << 20;
+        size_t received = 0;
+        lines::SchedulerRun(
+            [&] {
+                auto writer = lines::Spawn([&] {
+                    std::string data(kSize, 'x');
+                    for (size_t written = 0; written < kSize;) {
+                        auto size = lines::io::Write(fds[1], data.data() + written,
+                                                     kSize - written);
+                        REQUIRE(size > 0);
+                        written += size;
+                    }
+                    close(fds[1]);
+                });
+
+                char buffer[4096];
+                while (auto size = lines::io::Read(fds[0], buffer, sizeof(buffer))) {
+                    REQUIRE(size > 0);
+                    received += size;
+                }
+                writer.join();
+            },
+            1);
+        REQUIRE(received == kSize);
+        close(fds[0]);
+    }
+
+    SECTION("Socketpair") {
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+
+        lines::SchedulerRun(
+            [&] {
+                auto echo = lines::Spawn([&] { Echo(fds[1]); });
+                for (int i = 0; i < 100; ++i) {
+                    char byte = static_cast<char>(i);
+                    REQUIRE(lines::io::Write(fds[0], &byte, 1) == 1);
+                    REQUIRE(lines::io::Read(fds[0], &byte, 1) == 1);
+                    REQUIRE(byte == static_cast<char>(i));
+                }
+                close(fds[0]);
+                echo.join();
+            },
+            1);
+    }
+
+    SECTION("Loopback") {
+        lines::SchedulerRun(
+            [&] {
+                sockaddr_in address;
+                int listener = ListenLoopback(&address);
+                auto server = lines::Spawn([&] {
+                    for (int i = 0; i < 3; ++i) {
+                        int fd = lines::io::Accept(listener);
+                        REQUIRE(fd >= 0);
+                        lines::Spawn([fd] { Echo(fd); }).detach();
+                    }
+                });
+
+                std::vector<lines::Handle> clients;
+                for (int i = 0; i < 3; ++i) {
+                    clients.push_back(lines::Spawn([&] { EchoRoundTrips(address, 10); }));
+                }
+                for (auto& client : clients) {
+                    client.join();
+                }
+                server.join();
+                close(listener);
+            },
+            1);
+    }
+
+    SECTION("ConnectionRefused") {
+        lines::SchedulerRun(
+            [&] {
+                sockaddr_in address;
+                close(ListenLoopback(&address));
+
+                int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+                auto result = lines::io::Connect(fd, reinterpret_cast<sockaddr*>(&address),
+                                                 sizeof(address));
+                REQUIRE(result == -1);
+                REQUIRE(errno == ECONNREFUSED);
+                close(fd);
+            },
+            1);
+    }
+}
+
+TEST_CASE("EchoBenchmark", "[.][benchmark]") {
+    constexpr int kClients = 8;
+    constexpr int kRoundTrips = 1000;
+
+    BENCHMARK("8 clients x 1000 round trips") {
+        lines::SchedulerRun(
+            [&] {
+                sockaddr_in address;
+                int listener = ListenLoopback(&address);
+                auto server = lines::Spawn([&] {
+                    for (int i = 0; i < kClients; ++i) {
+                        int fd = lines::io::Accept(listener);
+                        lines::Spawn([fd] { Echo(fd); }).detach();
+                    }
+                });
+
+                std::vector<lines::Handle> clients;
+                for (int i = 0; i < kClients; ++i) {
+                    clients.push_back(
+                        lines::Spawn([&] { EchoRoundTrips(address, kRoundTrips); }));
+                }
+                for (auto& client : clients) {
+                    client.join();
+                }
+                server.join();
+                close(listener);
+            },
+            1);
+    };
+}
+
+#endif
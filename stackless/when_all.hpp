@@ -0,0 +1,325 @@
+#pragma once
+
+#include <stackless/async_task.hpp>
+#include <stackless/cancellation.hpp>
+
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+// Class declarations
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+/// Combinators report results of `AsyncTask<void>` as Unit.
+template <class T>
+using TaskResult = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+/// A vector cannot hold references: results of `AsyncTask<T&>` in a range
+/// are returned as `std::reference_wrapper<T>`.
+template <class T>
+using RangeResult = std::conditional_t<std::is_reference_v<T>,
+                                       std::reference_wrapper<std::remove_reference_t<T>>,
+                                       TaskResult<T>>;
+
+}  // namespace detail
+
+/// Result of `WhenAny`: the index of the first completed task and its result.
+template <class T>
+struct WhenAnyResult {
+    size_t index;
+    detail::TaskResult<T> value;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+/// Shared countdown of the children started by a combinator.
+///
+/// Starts at `count + 1`: the extra unit is released by the awaiting coroutine
+/// once every child is started, so the coroutine is resumed exactly once,
+/// either inline or by symmetric transfer from the last child to complete.
+class JoinCounter : public CompletionWaiter {
+public:
+    explicit JoinCounter(size_t count) noexcept : remaining_(count + 1) {
+    }
+
+    void SetAwaiting(std::coroutine_handle<> awaiting) noexcept {
+        awaiting_ = awaiting;
+    }
+
+    /// Cancels the source once the first child completes.
+    void SetCancelOnFirst(CancellationSource* source) noexcept {
+        cancel_on_first_ = source;
+    }
+
+    template <class T>
+    void Start(const AsyncTask<T>& task, const CancellationToken& token) noexcept {
+        auto handle = AsyncTaskAccess::GetHandle(task);
+        handle.promise().InheritCancellationToken(token);
+        handle.promise().GetCompletion().Subscribe(this);
+        handle.resume();
+    }
+
+    /// Returns true if the awaiting coroutine should stay suspended.
+    bool Started() noexcept {
+        return remaining_.fetch_sub(1, std::memory_order::acq_rel) > 1;
+    }
+
+    std::coroutine_handle<> OnComplete(std::coroutine_handle<> task) noexcept override {
+        void* expected = nullptr;
+        if (first_.compare_exchange_strong(expected, task.address(), std::memory_order::relaxed) &&
+            cancel_on_first_) {
+            cancel_on_first_->RequestCancellation();
+        }
+
+        if (remaining_.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+            return awaiting_;
+        }
+        return std::noop_coroutine();
+    }
+
+    /// Checks whether the task was the first one to complete.
+    template <class T>
+    bool IsFirst(const AsyncTask<T>& task) const noexcept {
+        auto first = first_.load(std::memory_order::relaxed);
+        return AsyncTaskAccess::GetHandle(task).address() == first;
+    }
+
+private:
+    std::atomic<size_t> remaining_;
+    std::atomic<void*> first_{nullptr};
+    std::coroutine_handle<> awaiting_{};
+    CancellationSource* cancel_on_first_ = nullptr;
+};
+
+/// Forwards cancellation of the awaiting task to the source of its children.
+class CancellationLink : public CancellationCallback {
+public:
+    explicit CancellationLink(CancellationSource& source) noexcept : source_(&source) {
+    }
+
+    void OnCancel() noexcept override {
+        source_->RequestCancellation();
+    }
+
+private:
+    CancellationSource* source_;
+};
+
+// Children of a combinator inherit the token of the awaiting task.
+template <class Promise>
+CancellationToken GetAwaitingToken(std::coroutine_handle<Promise> awaiting) noexcept {
+    if constexpr (std::is_base_of_v<AsyncTaskPromiseBase, Promise>) {
+        return awaiting.promise().GetCancellationToken();
+    } else {
+        return {};
+    }
+}
+
+template <class T>
+void CheckValid(const AsyncTask<T>& task) {
+    if (!task.IsValid()) {
+        throw AsyncTaskInvalid();
+    }
+}
+
+// Takes the result from the completed task, its frame is released with the task.
+template <class T>
+TaskResult<T> TakeResult(const AsyncTask<T>& task) {
+    if constexpr (std::is_void_v<T>) {
+        AsyncTaskAccess::GetHandle(task).promise().GetResult();
+        return Unit{};
+    } else {
+        return AsyncTaskAccess::GetHandle(task).promise().GetResult();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Awaits a fixed set of possibly heterogeneous tasks.
+template <class... Ts>
+class WhenAllAwaiter {
+public:
+    explicit WhenAllAwaiter(AsyncTask<Ts>&&... tasks)
+        : tasks_(std::move(tasks)...), counter_(sizeof...(Ts)) {
+        std::apply([](const auto&... task) { (CheckValid(task), ...); }, tasks_);
+    }
+
+    bool await_ready() noexcept {
+        return sizeof...(Ts) == 0;
+    }
+
+    template <class Promise>
+    bool await_suspend(std::coroutine_handle<Promise> awaiting) noexcept {
+        auto token = GetAwaitingToken(awaiting);
+        counter_.SetAwaiting(awaiting);
+        std::apply([&](const auto&... task) { (counter_.Start(task, token), ...); }, tasks_);
+        return counter_.Started();
+    }
+
+    // Results are taken in order, the first failed task rethrows its exception.
+    std::tuple<TaskResult<Ts>...> await_resume() {
+        return std::apply(
+            [](const auto&... task) { return std::tuple<TaskResult<Ts>...>{TakeResult(task)...}; },
+            tasks_);
+    }
+
+private:
+    std::tuple<AsyncTask<Ts>...> tasks_;
+    JoinCounter counter_;
+};
+
+/// Awaits a range of homogeneous tasks, stored in `Container`.
+template <class T, class Container>
+class WhenAllRangeAwaiter {
+public:
+    explicit WhenAllRangeAwaiter(Container tasks)
+        : tasks_(std::move(tasks)), counter_(std::size(tasks_)) {
+        for (const auto& task : tasks_) {
+            CheckValid(task);
+        }
+    }
+
+    bool await_ready() noexcept {
+        return std::empty(tasks_);
+    }
+
+    template <class Promise>
+    bool await_suspend(std::coroutine_handle<Promise> awaiting) noexcept {
+        auto token = GetAwaitingToken(awaiting);
+        counter_.SetAwaiting(awaiting);
+        for (const auto& task : tasks_) {
+            counter_.Start(task, token);
+        }
+        return counter_.Started();
+    }
+
+    std::vector<RangeResult<T>> await_resume() {
+        std::vector<RangeResult<T>> results;
+        results.reserve(std::size(tasks_));
+        for (const auto& task : tasks_) {
+            results.push_back(TakeResult(task));
+        }
+        return results;
+    }
+
+private:
+    Container tasks_;
+    JoinCounter counter_;
+};
+
+/// Awaits every task of a range and reports the first one to complete.
+template <class T, class Container>
+class WhenAnyAwaiter {
+public:
+    explicit WhenAnyAwaiter(Container tasks)
+        : tasks_(std::move(tasks)), counter_(std::size(tasks_)), link_(source_) {
+        if (std::empty(tasks_)) {
+            throw std::invalid_argument("WhenAny requires at least one task");
+        }
+        for (const auto& task : tasks_) {
+            CheckValid(task);
+        }
+    }
+
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    // The children get a token of their own, so that the losers
+    // may be cancelled without cancelling the awaiting task.
+    template <class Promise>
+    bool await_suspend(std::coroutine_handle<Promise> awaiting) noexcept {
+        if (!link_.Register(GetAwaitingToken(awaiting))) {
+            source_.RequestCancellation();
+        }
+
+        auto token = source_.GetToken();
+        counter_.SetAwaiting(awaiting);
+        counter_.SetCancelOnFirst(&source_);
+        for (const auto& task : tasks_) {
+            counter_.Start(task, token);
+        }
+        return counter_.Started();
+    }
+
+    // Only the result of the first task matters, the others are dropped.
+    WhenAnyResult<T> await_resume() {
+        size_t index = 0;
+        while (!counter_.IsFirst(tasks_[index])) {
+            ++index;
+        }
+        return WhenAnyResult<T>{index, TakeResult(tasks_[index])};
+    }
+
+private:
+    Container tasks_;
+    JoinCounter counter_;
+    CancellationSource source_;
+    CancellationLink link_;
+};
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+// Combinators
+////////////////////////////////////////////////////////////////////////////////
+
+/// Starts all the tasks and resumes the awaiting coroutine once every one of
+/// them is completed. The result is a tuple of their results, `AsyncTask<void>`
+/// contributes Unit. If some tasks fail, the exception of the first one
+/// (in argument order) is rethrown.
+///
+/// No allocations are made besides the frames of the tasks themselves.
+/// The tasks inherit the cancellation token of the awaiting task.
+///
+/// Preconditions:
+/// - `IsValid() == true` for every task (else throws AsyncTaskInvalid)
+template <class... Ts>
+[[nodiscard]] detail::WhenAllAwaiter<Ts...> WhenAll(AsyncTask<Ts>... tasks) {
+    return detail::WhenAllAwaiter<Ts...>(std::move(tasks)...);
+}
+
+/// Range form of `WhenAll`, the results are returned in the order of the tasks.
+/// References are returned as `std::reference_wrapper`.
+template <class T>
+[[nodiscard]] detail::WhenAllRangeAwaiter<T, std::vector<AsyncTask<T>>> WhenAll(
+    std::vector<AsyncTask<T>> tasks) {
+    return detail::WhenAllRangeAwaiter<T, std::vector<AsyncTask<T>>>(std::move(tasks));
+}
+
+/// Starts all the tasks and returns the index and the result of the first one
+/// to complete. The other tasks are cancelled, and the awaiting coroutine is
+/// resumed when every task is finished, so none of them outlive the await.
+///
+/// Preconditions:
+/// - at least one task (else throws std::invalid_argument)
+/// - `IsValid() == true` for every task (else throws AsyncTaskInvalid)
+template <class T, class... Ts>
+    requires(std::is_same_v<T, Ts> && ...)
+[[nodiscard]] detail::WhenAnyAwaiter<T, std::array<AsyncTask<T>, sizeof...(Ts) + 1>> WhenAny(
+    AsyncTask<T> task, AsyncTask<Ts>... tasks) {
+    using Tasks = std::array<AsyncTask<T>, sizeof...(Ts) + 1>;
+    return detail::WhenAnyAwaiter<T, Tasks>(Tasks{std::move(task), std::move(tasks)...});
+}
+
+/// Range form of `WhenAny`.
+template <class T>
+[[nodiscard]] detail::WhenAnyAwaiter<T, std::vector<AsyncTask<T>>> WhenAny(
+    std::vector<AsyncTask<T>> tasks) {
+    return detail::WhenAnyAwaiter<T, std::vector<AsyncTask<T>>>(std::move(tasks));
+}
+
+}  // namespace coro